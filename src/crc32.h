@@ -0,0 +1,159 @@
+/*
+Copyright 2022, Yves Gallot
+
+genefer is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64) || defined(__i386__)) && defined(__GNUC__)
+#define CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ARMV8
+#include <arm_acle.h>
+#endif
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xedb88320).
+// Slicing-by-8 tables, folding with carry-less multiplication (PCLMULQDQ) or ARMv8 CRC instructions if available.
+// The tables and the CPU detection are initialized once (thread-safe static initialization).
+class crcEngine
+{
+private:
+	uint32_t _table[8][256];
+	bool _pclmul = false;
+
+	crcEngine()
+	{
+		for (size_t i = 0; i < 256; ++i)
+		{
+			uint32_t rem = static_cast<uint32_t>(i);
+			for (size_t j = 0; j < 8; ++j) rem = (rem & 1) ? (rem >> 1) ^ 0xedb88320 : rem >> 1;
+			_table[0][i] = rem;
+		}
+		for (size_t i = 0; i < 256; ++i)
+		{
+			for (size_t k = 1; k < 8; ++k) _table[k][i] = (_table[k - 1][i] >> 8) ^ _table[0][_table[k - 1][i] & 0xff];
+		}
+#if defined(CRC32_PCLMUL)
+		__builtin_cpu_init();
+		_pclmul = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#endif
+	}
+
+	static const crcEngine & getInstance()
+	{
+		static const crcEngine instance;
+		return instance;
+	}
+
+	// crc is the internal state (not complemented)
+	uint32_t slice8(const uint32_t crc, const uint8_t * const buf, const size_t len) const
+	{
+		uint32_t c = crc;
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8)
+		{
+			uint32_t lo, hi; std::memcpy(&lo, &buf[i], sizeof(lo)); std::memcpy(&hi, &buf[i + 4], sizeof(hi));	// little-endian
+			lo ^= c;
+			c = _table[7][lo & 0xff] ^ _table[6][(lo >> 8) & 0xff] ^ _table[5][(lo >> 16) & 0xff] ^ _table[4][lo >> 24]
+			  ^ _table[3][hi & 0xff] ^ _table[2][(hi >> 8) & 0xff] ^ _table[1][(hi >> 16) & 0xff] ^ _table[0][hi >> 24];
+		}
+		for (; i < len; ++i) c = (c >> 8) ^ _table[0][(c ^ buf[i]) & 0xff];
+		return c;
+	}
+
+#if defined(CRC32_PCLMUL)
+	// Intel, Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction. len >= 64, len % 16 = 0
+	__attribute__((target("pclmul,sse4.1")))
+	static uint32_t pclmul(const uint32_t crc, const uint8_t * buf, size_t len)
+	{
+		const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4), k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+		const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124), poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+		const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+		__m128i x1 = _mm_loadu_si128((const __m128i *)&buf[0x00]), x2 = _mm_loadu_si128((const __m128i *)&buf[0x10]);
+		__m128i x3 = _mm_loadu_si128((const __m128i *)&buf[0x20]), x4 = _mm_loadu_si128((const __m128i *)&buf[0x30]);
+		x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+		buf += 64; len -= 64;
+
+		// fold by 4
+		while (len >= 64)
+		{
+			const __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00), x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+			const __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00), x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+			x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11); x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+			x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11); x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+			x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)&buf[0x00]));
+			x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)&buf[0x10]));
+			x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)&buf[0x20]));
+			x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)&buf[0x30]));
+			buf += 64; len -= 64;
+		}
+
+		// fold into 128 bits
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x2);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x3);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x4);
+
+		while (len >= 16)
+		{
+			x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)),
+							   _mm_loadu_si128((const __m128i *)buf));
+			buf += 16; len -= 16;
+		}
+
+		// fold 128 bits to 64 bits
+		x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+		x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+		x2 = _mm_srli_si128(x1, 4);
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+
+		// Barrett reduction to 32 bits
+		x2 = _mm_and_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10), mask32);
+		x1 = _mm_xor_si128(x1, _mm_clmulepi64_si128(x2, poly, 0x00));
+
+		return static_cast<uint32_t>(_mm_extract_epi32(x1, 1));
+	}
+#endif
+
+#if defined(CRC32_ARMV8)
+	static uint32_t armv8(const uint32_t crc, const uint8_t * const buf, const size_t len)
+	{
+		uint32_t c = crc;
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8) { uint64_t x; std::memcpy(&x, &buf[i], sizeof(x)); c = __crc32d(c, x); }
+		for (; i < len; ++i) c = __crc32b(c, buf[i]);
+		return c;
+	}
+#endif
+
+public:
+	// Same checksum as the byte-at-a-time algorithm: crc32 is the previous checksum (0 for the first buffer)
+	static uint32_t update(const uint32_t crc32, const char * const buf, const size_t len)
+	{
+		const uint8_t * const ubuf = reinterpret_cast<const uint8_t *>(buf);
+		uint32_t c = ~crc32;
+#if defined(CRC32_ARMV8)
+		c = armv8(c, ubuf, len);
+#else
+		const crcEngine & engine = getInstance();
+		size_t i = 0;
+#if defined(CRC32_PCLMUL)
+		if (engine._pclmul && (len >= 64))
+		{
+			const size_t plen = len & ~size_t(15);
+			c = pclmul(c, ubuf, plen);
+			i = plen;
+		}
+#endif
+		c = engine.slice8(c, &ubuf[i], len - i);
+#endif
+		return ~c;
+	}
+};
@@ -8,6 +8,8 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #pragma once
 
 #include <iomanip>
+#include <algorithm>
+#include <vector>
 
 #include <gmp.h>
 
@@ -18,6 +20,7 @@ Please give feedback to the authors if improvement is realized. It is distribute
 // #endif
 
 #include "pio.h"
+#include "crc32.h"
 
 class file
 {
@@ -25,6 +28,10 @@ private:
 	const std::string _filename;
 	FILE * const _cFile;
 	const bool _fatal;
+	std::string * const _errorStr = nullptr;	// if set, the first error is stored and not reported
+	std::vector<char> * const _buffer = nullptr;	// if set, the data are written into memory
+	const std::vector<char> * const _rbuffer = nullptr;	// if set, the data are read from memory
+	size_t _rpos = 0;
 	// const bool _isSync;
 	uint32_t _crc32 = 0;
 
@@ -41,6 +48,21 @@ public:
 		// _cFile may be null
 	}
 
+	// pio is not called: the error is returned into errorStr (a thread that is not the main thread)
+	file(const std::string & filename, const char * const mode, std::string & errorStr)
+		: _filename(filename), _cFile(pio::open(filename.c_str(), mode)), _fatal(false), _errorStr(&errorStr), _crc32(0)
+	{
+		if (_cFile == nullptr) error("cannot open file");
+	}
+
+	// write only, the data are appended to buffer
+	explicit file(std::vector<char> & buffer)
+		: _filename("memory"), _cFile(nullptr), _fatal(false), _buffer(&buffer), _crc32(0) {}
+
+	// read only, the data are read from buffer. The error is returned into errorStr (a thread that is not the main thread)
+	file(const std::vector<char> & buffer, std::string & errorStr)
+		: _filename("memory"), _cFile(nullptr), _fatal(false), _errorStr(&errorStr), _rbuffer(&buffer), _crc32(0) {}
+
 	virtual ~file()
 	{
 		if (_cFile != nullptr)
@@ -60,6 +82,7 @@ public:
 	void error(const std::string & str) const
 	{
 		std::ostringstream ss; ss << _filename << ": " << str;
+		if (_errorStr != nullptr) { if (_errorStr->empty()) *_errorStr = ss.str(); return; }
 		pio::error(ss.str(), _fatal);
 	}
 
@@ -67,44 +90,17 @@ public:
 
 	uint32_t crc32() const { return _crc32; }
 
-	// Rosetta Code, CRC-32, C
-	static uint32_t rc_crc32(const uint32_t crc32, const char * const buf, const size_t len)
-	{
-		static uint32_t table[256];
-		static bool have_table = false;
-	
-		// This check is not thread safe; there is no mutex
-		if (!have_table)
-		{
-			// Calculate CRC table
-			for (size_t i = 0; i < 256; ++i)
-			{
-				uint32_t rem = static_cast<uint32_t>(i);  // remainder from polynomial division
-				for (size_t j = 0; j < 8; ++j)
-				{
-					if (rem & 1)
-					{
-						rem >>= 1;
-						rem ^= 0xedb88320;
-					}
-					else rem >>= 1;
-				}
-				table[i] = rem;
-			}
-			have_table = true;
-		}
-
-		uint32_t crc = ~crc32;
-		for (size_t i = 0; i < len; ++i)
-		{
-			const uint8_t octet = static_cast<uint8_t>(buf[i]);  // Cast to unsigned octet
-			crc = (crc >> 8) ^ table[(crc & 0xff) ^ octet];
-		}
-		return ~crc;
-	}
+	static uint32_t rc_crc32(const uint32_t crc32, const char * const buf, const size_t len) { return crcEngine::update(crc32, buf, len); }
 
 	bool read(char * const ptr, const size_t size)
 	{
+		if (_rbuffer != nullptr)
+		{
+			if (_rpos + size > _rbuffer->size()) { error("failure of a read operation"); return false; }
+			std::copy(_rbuffer->data() + _rpos, _rbuffer->data() + _rpos + size, ptr); _rpos += size;
+			_crc32 = rc_crc32(_crc32, ptr, size);
+			return true;
+		}
 		const size_t ret = std::fread(ptr , sizeof(char), size, _cFile);
 		_crc32 = rc_crc32(_crc32, ptr, size);
 		if (ret == size * sizeof(char)) return true;
@@ -114,6 +110,7 @@ public:
 
 	bool write(const char * const ptr, const size_t size)
 	{
+		if (_buffer != nullptr) { _buffer->insert(_buffer->end(), ptr, ptr + size); _crc32 = rc_crc32(_crc32, ptr, size); return true; }
 		const size_t ret = std::fwrite(ptr , sizeof(char), size, _cFile);
 		_crc32 = rc_crc32(_crc32, ptr, size);
 		if (ret == size * sizeof(char)) return true;
@@ -14,13 +14,22 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include <stdexcept>
 #include <cmath>
 #include <thread>
+#include <atomic>
 #include <chrono>
 #include <ctime>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <algorithm>
+#include <random>
 #include <sys/stat.h>
 
 #include <gmp.h>
 #if !defined(GPU)
 #include <omp.h>
+#if defined(__x86_64) || defined(__i386__)
+#include <cpuid.h>
+#endif
 #endif
 
 #include "pio.h"
@@ -30,21 +39,49 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include "ocl.h"
 #endif
 #include "transform.h"
+#include "writer.h"
 
 inline int ilog2_32(const uint32_t n) { return 31 - __builtin_clz(n); }
 
+#if !defined(GPU)
+// A single-threaded copy of the transform of the test with a single register: the raw registers are converted by the writer thread
+class rawConverter : public ckptWriter::converter
+{
+private:
+	transform * const _t;
+
+public:
+	rawConverter(transform * const t) : _t(t) {}
+	virtual ~rawConverter() { delete _t; }
+
+	bool getInt(const std::vector<char> & raw, gint & g) override
+	{
+		std::string errorStr;
+		file rawFile(raw, errorStr);
+		if (!_t->readContext(rawFile, 1)) return false;
+		_t->getInt(g);
+		return true;
+	}
+};
+#endif
+
 class genefer
 {
 public:
 	enum class EReturn { Success, Failed, Aborted }; 
 	enum class EMode { None, Quick, Proof, Server, Check, Bench, Limit }; 
+	enum class EPool { OpenMP, Spin, Park };
 
 private:
 	struct deleter { void operator()(const genefer * const p) { delete p; } };
+#if !defined(GPU)
+	static constexpr size_t max_threads = 64;	// the CPU transforms support 64 threads
+	static constexpr double sampling_margin = 0.9;	// the round-off error is sampled if b > 0.9 b_max
+#endif
 
 public:
-	genefer() {}
-	virtual ~genefer() {}
+	genefer() : _writer(new ckptWriter()) {}
+	virtual ~genefer() { deleteTransform(); delete _writer; }
 
 	static genefer & getInstance()
 	{
@@ -61,11 +98,37 @@ private:
 	cl_device_id _boinc_device_id = 0;
 #endif
 	transform * _transform = nullptr;
+	bool _reuseTransform = false;
+	uint32_t _t_n = 0;
+	size_t _t_nthreads = 0, _t_num_regs = 0;
+	std::string _t_impl;
+#if !defined(GPU)
+	transform::plan _t_plan = { false, transform::EFamily::Auto };
+	bool _isCtxPlan = false;	// the transform of the test is fixed: the transform of a raw context or a safer transform (escalateTransform)
+	transform::plan _ctx_plan = { false, transform::EFamily::Auto };
+#endif
 	gint * _gi = nullptr;
+	ckptWriter * const _writer;
+#if !defined(GPU)
+	rawConverter * _converter = nullptr;	// the proof checkpoints of the transform
+#endif
 	std::string _mainFilename;
 	uint32_t _n = 0;
 	int _print_range = 0, _print_i = 0;
 	bool _print_sr = true;
+	double _glPeriod = 600;
+	EPool _pool = EPool::OpenMP;
+	bool _portableContext = false;
+	size_t _num_regs = 0;
+	size_t _memBudget = 0;	// MB
+	size_t _diskBudget = 4096;	// MB, the checkpoints of the proof
+	size_t _mem_ckpts = 0;	// the first checkpoints of the proof are held in registers 3, 4, ...
+	size_t _reg_size = 0;	// the memory of a register of the transform (bytes)
+	std::map<uint32_t, std::pair<std::string, size_t>> _tuning;	// n => implementation, number of threads
+	bool _limitExact = false;
+	bool _errorSampling = false;	// the round-off error is checked at sampled iterations of the test
+	bool _escalated = false;		// the test was switched to a safer transform, the contexts are portable
+	transform::EFamily _kind = transform::EFamily::Auto;	// the CPU transform is selected by the cost model if Auto
 
 public:
 	void quit() { _quit = true; }
@@ -78,6 +141,14 @@ public:
 	}
 #endif
 	void setFilename(const std::string & mainFilename) { _mainFilename = mainFilename; }
+	void setGLPeriod(const double glPeriod) { _glPeriod = glPeriod; }
+	void setPool(const EPool pool) { _pool = pool; }
+	void setPortableContext(const bool portableContext) { _portableContext = portableContext; }
+	void setMemBudget(const size_t memBudget) { _memBudget = memBudget; }
+	void setDiskBudget(const size_t diskBudget) { _diskBudget = diskBudget; }
+	void setReuseTransform(const bool reuseTransform) { _reuseTransform = reuseTransform; }
+	void setLimitExact(const bool limitExact) { _limitExact = limitExact; }
+	void setKind(const transform::EFamily kind) { _kind = kind; }
 
 private:
 #if defined(GPU)
@@ -85,7 +156,9 @@ private:
 							const bool verbose = true, const bool full = true)
 	{
 		deleteTransform();
+		_num_regs = num_regs;
 		_transform = transform::create_gpu(b, n, _isBoinc, device, num_regs, _boinc_platform_id, _boinc_device_id, verbose);
+		setMultiplicands(num_regs);
 		if (verbose)
 		{
 			std::ostringstream ss;
@@ -95,12 +168,28 @@ private:
 		}
 	}
 #else
+	transform::plan getPlan(const uint32_t b, const uint32_t n, const std::string & impl) const
+	{
+		return (_isCtxPlan && (impl != "i32")) ? _ctx_plan : transform::getPlan(b, n, impl, _kind);
+	}
+
 	void createTransformCPU(const uint32_t b, const uint32_t n, const size_t nthreads, const std::string & impl, const size_t num_regs,
 							const bool checkError, const bool verbose = true, const bool full = true)
 	{
+		// twiddle factors don't depend on b: the transform of the previous test can be reused if the family is unchanged
+		const transform::plan plan = getPlan(b, n, impl);
+		if (_reuseTransform && (_transform != nullptr) && (n == _t_n) && (nthreads == _t_nthreads) && (impl == _t_impl) && (num_regs <= _t_num_regs)
+			&& (plan == _t_plan))
+		{
+			if (_transform->setBase(b, checkError)) { deleteConverter(); _num_regs = num_regs; setMultiplicands(_t_num_regs); return; }
+		}
+
 		deleteTransform();
+		_t_n = n; _t_nthreads = nthreads; _t_num_regs = num_regs; _t_impl = impl; _t_plan = plan;
+		_num_regs = num_regs;
 
-		if (nthreads > 1) omp_set_num_threads(static_cast<int>(nthreads));
+		// the buffers of the transforms are allocated for at most max_threads threads
+		if (nthreads > 1) omp_set_num_threads(static_cast<int>(std::min(nthreads, max_threads)));
 		size_t num_threads = 1;
 		if (nthreads != 1)
 		{
@@ -109,13 +198,24 @@ private:
 #pragma omp single
 				num_threads = size_t(omp_get_num_threads());
 			}
+			if (num_threads > max_threads)
+			{
+				num_threads = max_threads;
+				omp_set_num_threads(static_cast<int>(num_threads));
+			}
 		}
 
 		std::string ttype;
-		_transform = transform::create_cpu(b, n, num_threads, impl, num_regs, checkError, ttype);
+		_transform = transform::create_cpu(b, n, num_threads, impl, plan, num_regs, checkError, ttype);
+		if ((_pool != EPool::OpenMP) && (num_threads > 1))
+		{
+			_transform->setThreadPool((_pool == EPool::Spin) ? threadPool::EWait::Spin : threadPool::EWait::Park);
+		}
+		setMultiplicands(num_regs);
 		if (verbose)
 		{
-			std::ostringstream ss; ss << "Using " << ttype << " implementation, " << num_threads << " thread(s)";
+			std::ostringstream ss; ss << "Using " << ttype << " implementation (" << _transform->getKindName() << "), " << num_threads << " thread(s)";
+			if ((_pool != EPool::OpenMP) && (num_threads > 1)) ss << " (thread pool)";
 			if (full) ss << ", data size: " << std::setprecision(3) << _transform->getCacheSize() / (1024 * 1024.0) << " MB";
 			ss << "." << std::endl;
 			pio::print(ss.str());
@@ -123,8 +223,34 @@ private:
 	}
 #endif
 
+#if !defined(GPU)
+	ckptWriter::converter & converter()
+	{
+		if (_converter == nullptr)
+		{
+			std::string ttype;
+			_converter = new rawConverter(transform::create_cpu(_gi->getBase(), _n, 1, _t_impl, _t_plan, 1, false, ttype));
+		}
+		return *_converter;
+	}
+
+	// the pending jobs of the writer may use the converter
+	void deleteConverter()
+	{
+		if (_converter != nullptr)
+		{
+			_writer->wait();
+			delete _converter;
+			_converter = nullptr;
+		}
+	}
+#endif
+
 	void deleteTransform()
 	{
+#if !defined(GPU)
+		deleteConverter();
+#endif
 		if (_transform != nullptr)
 		{
 			delete _transform;
@@ -133,6 +259,8 @@ private:
 	}
 
 	std::string contextFilename() const { return _mainFilename + ".ctx"; }
+	std::string checkContextFilename() const { return _mainFilename + ".ctx2"; }
+	std::string depthFilename() const { return _mainFilename + ".depth"; }
 	std::string proofFilename() const { return _mainFilename + ".proof"; }
 	std::string sfvFilename() const { return _mainFilename + ".sfv"; }
 	std::string certFilename() const { return _mainFilename + ".cert"; }
@@ -217,30 +345,93 @@ private:
 
 	static void clearline() { pio::display("                                                \r"); }
 
-	int _readContext(const std::string  & filename, const int where, const bool fast_checkpoints, int & i, double & elapsedTime)
+	// The two layouts of a check context (1: sequential, 2: concurrent) are accepted, where is set to the layout of the file
+	int _readContext(const std::string  & filename, int & where, const bool fast_checkpoints, int & i, double & elapsedTime)
 	{
 		file contextFile(filename);
 		if (!contextFile.exists()) return -1;
 
 		int version = 0;
 		if (!contextFile.read(reinterpret_cast<char *>(&version), sizeof(version))) return -2;
+		const bool portable = (version == 2);
 #if defined(GPU)
-		version = -version;
+		if (!portable) version = -version;
 #endif
-		if (version != 1) return -2;
+		if ((version != 1) && !portable) return -2;
 		int rwhere = 0;
 		if (!contextFile.read(reinterpret_cast<char *>(&rwhere), sizeof(rwhere))) return -2;
-		if (rwhere != where) return -2;
+		if ((rwhere != where) && ((where == 0) || (rwhere != 3 - where))) return -2;
 		if (!contextFile.read(reinterpret_cast<char *>(&i), sizeof(i))) return -2;
 		if (!contextFile.read(reinterpret_cast<char *>(&elapsedTime), sizeof(elapsedTime))) return -2;
-		const size_t num_reg = (where == 0) ? 2 : 3;
-		if (!_transform->readContext(contextFile, fast_checkpoints ? 0 : num_reg)) return -2;
+		const size_t num_reg = (rwhere == 0) ? 2 : 3;
+		if (portable) { if (!readPortableContext(contextFile, fast_checkpoints ? _num_regs : num_reg)) return -2; }
+		else if (!_transform->readContext(contextFile, fast_checkpoints ? _num_regs : num_reg)) return -2;
 		if (!contextFile.check_crc32()) return -2;
+		where = rwhere;
 		return 0;
 	}
 
-	bool readContext(const int where, const bool fast_checkpoints, int & i, double & elapsedTime)
+	// The portable context contains the registers as digit vectors: it can be resumed with any implementation
+	bool readPortableContext(file & contextFile, const size_t num_reg)
+	{
+		gint & gi = *_gi;
+
+		uint32_t b = 0, n = 0, nr = 0;
+		if (!contextFile.read(reinterpret_cast<char *>(&b), sizeof(b))) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&n), sizeof(n))) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&nr), sizeof(nr))) return false;
+		if ((b != gi.getBase()) || (n != _n) || (size_t(nr) != num_reg)) return false;
+
+		for (size_t r = 0; r < num_reg; ++r)
+		{
+			gi.read(contextFile);
+			_transform->swap(0, r);
+			_transform->setInt(gi);
+			_transform->swap(0, r);
+		}
+		return true;
+	}
+
+	// The registers are converted into the staging buffer of the job, the file is written by the writer thread
+	void savePortableContext(ckptWriter::job & ctxJob, const size_t num_reg) const
+	{
+		const gint & gi = *_gi;
+
+		const uint32_t b = gi.getBase(), n = _n, nr = static_cast<uint32_t>(num_reg);
+		ctxJob.header(b); ctxJob.header(n); ctxJob.header(nr);
+
+		for (size_t r = 0; r < num_reg; ++r)
+		{
+			_transform->swap(0, r);
+			_transform->getInt(ctxJob.reg(gi.getSize(), gi.getBase()));
+			_transform->swap(0, r);
+		}
+	}
+
+#if !defined(GPU)
+	// The plan of the transform of a raw context. A portable context can be resumed with any transform.
+	bool readContextPlan(transform::plan & plan) const
+	{
+		for (const std::string & ctxFile : { contextFilename(), contextFilename() + ".old" })
+		{
+			file contextFile(ctxFile);
+			if (!contextFile.exists()) continue;
+
+			int version = 0, where = 0, i = 0; double elapsedTime = 0;
+			if (!contextFile.read(reinterpret_cast<char *>(&version), sizeof(version))) continue;
+			if (version != 1) return false;
+			if (!contextFile.read(reinterpret_cast<char *>(&where), sizeof(where))) continue;
+			if (!contextFile.read(reinterpret_cast<char *>(&i), sizeof(i))) continue;
+			if (!contextFile.read(reinterpret_cast<char *>(&elapsedTime), sizeof(elapsedTime))) continue;
+			if (transform::readPlan(contextFile, plan)) return true;
+		}
+		return false;
+	}
+#endif
+
+	bool readContext(int & where, const bool fast_checkpoints, int & i, double & elapsedTime)
 	{
+		_writer->wait();
 		std::string ctxFile = contextFilename();
 		int error = _readContext(ctxFile, where, fast_checkpoints, i, elapsedTime);
 		if (error < -1)
@@ -261,46 +452,73 @@ private:
 		return (error == 0);
 	}
 
+	// The context is staged into a job of the writer: portable (registers) or raw (the memory of the transform)
 	void saveContext(const int where, const bool fast_checkpoints, const int i, const double elapsedTime) const
 	{
-		const std::string ctxFile = contextFilename(), oldCtxFile = ctxFile + ".old", newCtxFile = ctxFile + ".new";
+		const std::string ctxFile = contextFilename();
+		const size_t num_reg = (where == 0) ? 2 : 3;
+
+		ckptWriter::job & ctxJob = _writer->acquire();
+		ctxJob.init(ctxFile, true, false);
 
+		if (_portableContext || _escalated)
+		{
+			const int version = 2;
+			ctxJob.header(version); ctxJob.header(where); ctxJob.header(i); ctxJob.header(elapsedTime);
+			savePortableContext(ctxJob, fast_checkpoints ? _num_regs : num_reg);
+		}
+		else
 		{
-			file contextFile(newCtxFile, "wb", false);
 			int version = 1;
 #if defined(GPU)
 			version = -version;
 #endif
-			if (!contextFile.write(reinterpret_cast<const char *>(&version), sizeof(version))) return;
-			if (!contextFile.write(reinterpret_cast<const char *>(&where), sizeof(where))) return;
-			if (!contextFile.write(reinterpret_cast<const char *>(&i), sizeof(i))) return;
-			if (!contextFile.write(reinterpret_cast<const char *>(&elapsedTime), sizeof(elapsedTime))) return;
-			const size_t num_reg = (where == 0) ? 2 : 3;
-			_transform->saveContext(contextFile, fast_checkpoints ? 0 : num_reg);
-			contextFile.write_crc32();
+			ctxJob.header(version); ctxJob.header(where); ctxJob.header(i); ctxJob.header(elapsedTime);
+			file contextFile(ctxJob.data());
+			_transform->saveContext(contextFile, fast_checkpoints ? _num_regs : num_reg);
 		}
 
-		std::remove(oldCtxFile.c_str());
+		_writer->submit();
+		if (_isBoinc) _writer->wait();	// the checkpoint is completed
+	}
 
-		struct stat s;
-		if ((stat(ctxFile.c_str(), &s) == 0) && (std::rename(ctxFile.c_str(), oldCtxFile.c_str()) != 0))	// file exists and cannot rename it
-		{
-			pio::error("cannot save context");
-			return;
-		}
+	// The registers of the PRP test may be invalid since the last Gerbicz-Li check: the last verified state (u, d(t), i) is saved.
+	// The context is portable, the other registers are saved if fast_checkpoints is set.
+	void saveVerifiedContext(const bool fast_checkpoints, const gint & su, const gint & sd, const int si, const double elapsedTime) const
+	{
+		const gint & gi = *_gi;
+
+		ckptWriter::job & ctxJob = _writer->acquire();
+		ctxJob.init(contextFilename(), true, false);
 
-		if (std::rename(newCtxFile.c_str(), ctxFile.c_str()) != 0)
+		const int version = 2, where = 0;
+		ctxJob.header(version); ctxJob.header(where); ctxJob.header(si); ctxJob.header(elapsedTime);
+
+		const size_t num_reg = fast_checkpoints ? _num_regs : 2;
+		const uint32_t b = gi.getBase(), n = _n, nr = static_cast<uint32_t>(num_reg);
+		ctxJob.header(b); ctxJob.header(n); ctxJob.header(nr);
+
+		ctxJob.reg(gi.getSize(), gi.getBase()).copy(su);
+		ctxJob.reg(gi.getSize(), gi.getBase()).copy(sd);
+		for (size_t r = 2; r < num_reg; ++r)
 		{
-			pio::error("cannot save context");
-			return;
+			_transform->swap(0, r);
+			_transform->getInt(ctxJob.reg(gi.getSize(), gi.getBase()));
+			_transform->swap(0, r);
 		}
+
+		_writer->submit();
+		if (_isBoinc) _writer->wait();	// the checkpoint is completed
 	}
 
 	void clearContext() const
 	{
+		_writer->wait();
 		const std::string ctxFile = contextFilename();
 		std::remove(ctxFile.c_str());
 		std::remove(std::string(ctxFile + ".old").c_str());
+		std::remove(checkContextFilename().c_str());
+		std::remove(depthFilename().c_str());
 	}
 
 	static bool boincQuitRequest(const BOINC_STATUS & status)
@@ -345,6 +563,21 @@ private:
 	}
 
 	void boincMonitor(const int where, const bool fast_checkpoints, const int i, watch & chrono)
+	{
+		boincMonitor([&]() { saveContext(where, fast_checkpoints, i, chrono.getElapsedTime()); });
+	}
+
+	// save() writes the context if the task is suspended or if it is time to checkpoint
+	template<typename F>
+	void boincMonitor(const F & save)
+	{
+		boincMonitor(save, [&]() { save(); boinc_checkpoint_completed(); });
+	}
+
+	// save() writes the context if the task is suspended, checkpoint() is called if it is time to checkpoint:
+	// it must call boinc_checkpoint_completed() once the context is written.
+	template<typename F, typename G>
+	void boincMonitor(const F & save, const G & checkpoint)
 	{
 		BOINC_STATUS status; boinc_get_status(&status);
 		if (boincQuitRequest(status)) { quit(); return; }
@@ -352,7 +585,7 @@ private:
 		if (status.suspended != 0)
 		{
 			printState(true);
-			saveContext(where, fast_checkpoints, i, chrono.getElapsedTime());
+			save();
 			while (status.suspended != 0)
 			{
 				std::this_thread::sleep_for(std::chrono::milliseconds(100));
@@ -362,37 +595,78 @@ private:
 			printState(false);
 		}
 
-		if (boinc_time_to_checkpoint() != 0)
-		{
-			saveContext(where, fast_checkpoints, i, chrono.getElapsedTime());
-			boinc_checkpoint_completed();
-		}
+		if (boinc_time_to_checkpoint() != 0) checkpoint();
 	}
 
-	void power(const size_t reg, const uint32_t e) const
+	// Window size k of the sliding-window exponentiation: about L/(k + 1) multiplications and 2^{k-1} precomputed odd powers
+	static int windowSize(const int bitsize)
+	{
+		static const int k_max = 4;
+		int k = 1;
+		while ((k < k_max) && (bitsize / (k + 2) + (1 << k) < bitsize / (k + 1) + (1 << (k - 1)))) ++k;
+		return k;
+	}
+
+	// reg_0 = reg_src^e, bit(i) is the bit #i of e
+	template<typename F>
+	void powerWindow(const size_t src, const int bitsize, const F & bit) const
 	{
 		transform * const pTransform = _transform;
-		pTransform->initMultiplicand(reg);
-		pTransform->set(1);
-		if (e == 0) return;
-		for (int i = ilog2_32(e); i >= 0; --i)
+
+		// multiplicand #j is r_src^{2j+1}, #m is r_src^2. The window is reduced if the slots are not available.
+		int k = windowSize(bitsize);
+		while ((k > 1) && !pTransform->selectMultiplicand(size_t(1) << (k - 1))) --k;
+		const size_t m = size_t(1) << (k - 1);
+
+		pTransform->selectMultiplicand(0);
+		pTransform->initMultiplicand(src);
+		if (k > 1)
 		{
+			if (src != 0) pTransform->copy(0, src);
 			pTransform->squareDup(false);
-			if ((e & (static_cast<uint32_t>(1) << i)) != 0) pTransform->mul();
+			pTransform->selectMultiplicand(m);
+			pTransform->initMultiplicand(0);
+			for (size_t j = 1; j < m; ++j)
+			{
+				pTransform->selectMultiplicand((j == 1) ? 0 : m);
+				pTransform->mul();
+				pTransform->selectMultiplicand(j);
+				pTransform->initMultiplicand(0);
+			}
 		}
-	}
 
-	void powerz(const size_t reg, const mpz_t & e) const
-	{
-		transform * const pTransform = _transform;
-		pTransform->initMultiplicand(reg);
 		pTransform->set(1);
-		if (mpz_sgn(e) == 0) return;
-		for (int i = static_cast<int>(mpz_sizeinbase(e, 2) - 1); i >= 0; --i)
+		bool first = true;
+		for (int i = bitsize - 1; i >= 0;)
 		{
-			pTransform->squareDup(false);
-			if (mpz_tstbit(e, mp_bitcnt_t(i)) != 0) pTransform->mul();
+			if (!bit(i)) { pTransform->squareDup(false); --i; continue; }
+
+			int l = std::max(i - k + 1, 0);
+			while (!bit(l)) ++l;
+			size_t u = 0;
+			for (int j = i; j >= l; --j)
+			{
+				if (!first) pTransform->squareDup(false);
+				u = 2 * u + (bit(j) ? 1 : 0);
+			}
+			pTransform->selectMultiplicand(u / 2);
+			pTransform->mul();
+			first = false;
+			i = l - 1;
 		}
+		pTransform->selectMultiplicand(0);
+	}
+
+	void power(const size_t reg, const uint32_t e) const
+	{
+		const int bitsize = (e == 0) ? 0 : ilog2_32(e) + 1;
+		powerWindow(reg, bitsize, [=](const int i) { return (e & (static_cast<uint32_t>(1) << i)) != 0; });
+	}
+
+	void powerz(const size_t reg, const mpz_t & e) const
+	{
+		const int bitsize = (mpz_sgn(e) == 0) ? 0 : static_cast<int>(mpz_sizeinbase(e, 2));
+		powerWindow(reg, bitsize, [&](const int i) { return mpz_tstbit(e, mp_bitcnt_t(i)) != 0; });
 	}
 
 	static int B_GerbiczLi(const size_t esize)
@@ -406,14 +680,104 @@ private:
 		return static_cast<int>((esize - 1) >> depth) + 1;
 	}
 
-	// out: reg_0 is 2^exponent and reg_1 is d(t)
-	EReturn prp(const mpz_t & exponent, const int B_GL, const int B_PL, const bool fast_checkpoints, double & testTime)
+	// Gerbicz-Li error checking during the test
+	// in: reg_0 is u = 2^(exponent >> i), reg_1 is d(t)
+	// out: reg_0 is u, reg_1 is d(t + 1), gu is u, return valid/invalid
+	// A quit request doesn't abort the check: the state is saved once it is verified.
+	EReturn GLcheck(const mpz_t & exponent, const int B_GL, const int i, gint & gu)
 	{
 		transform * const pTransform = _transform;
 		gint & gi = *_gi;
 
-		int ri = 0; double restoredTime = 0;
-		const bool found = readContext(0, fast_checkpoints, ri, restoredTime);
+		pTransform->getInt(gu);
+
+		// d(t + 1) = d(t) * u
+		pTransform->mul(1);
+		pTransform->swap(0, 2);
+
+		// d(t)^{2^B}
+		pTransform->swap(0, 1);
+		for (int j = B_GL - 1; j >= 0; --j)
+		{
+			if (_isBoinc) boincMonitor();
+			pTransform->squareDup(false);
+		}
+		pTransform->swap(0, 1);
+
+		mpz_t res; mpz_init_set_ui(res, 0);
+		mpz_t e, t; mpz_init(e); mpz_init(t);
+		mpz_div_2exp(e, exponent, static_cast<unsigned long int>(i));
+		while (mpz_sgn(e) != 0)
+		{
+			mpz_mod_2exp(t, e, static_cast<unsigned long int>(B_GL));
+			mpz_add(res, res, t);
+			mpz_div_2exp(e, e, static_cast<unsigned long int>(B_GL));
+		}
+		mpz_clear(e); mpz_clear(t);
+
+		// 2^res
+		pTransform->set(1);
+		for (int j = static_cast<int>(mpz_sizeinbase(res, 2)) - 1; j >= 0; --j)
+		{
+			if (_isBoinc) boincMonitor();
+			pTransform->squareDup(mpz_tstbit(res, mp_bitcnt_t(j)) != 0);
+		}
+		mpz_clear(res);
+
+		// d(t)^{2^B} * 2^res ?= d(t + 1)
+		pTransform->mul(1);
+		pTransform->getInt(gi);
+		const uint64_t h1 = gi.gethash64();
+		pTransform->swap(0, 2);
+		pTransform->getInt(gi);
+		const uint64_t h2 = gi.gethash64();
+
+		pTransform->swap(0, 1);
+		pTransform->setInt(gu);
+
+		return (h1 == h2) ? EReturn::Success : EReturn::Failed;
+	}
+
+#if !defined(GPU)
+	// The round-off error is close to 1/2: the registers are converted to a safer transform (the next floating-point family or the NTT).
+	// The raw context of the new transform cannot be read by the default transform, the contexts are portable after the switch.
+	bool escalateTransform()
+	{
+		const gint & gi = *_gi;
+		transform::plan plan;
+		if (!transform::escalatePlan(gi.getBase(), _n, _t_plan, plan)) { _errorSampling = false; return false; }
+
+		const size_t num_regs = _num_regs;
+		std::vector<std::unique_ptr<gint>> regs;
+		for (size_t r = 0; r < num_regs; ++r)
+		{
+			regs.emplace_back(new gint(gi.getSize(), gi.getBase()));
+			_transform->swap(0, r); _transform->getInt(*regs.back()); _transform->swap(0, r);
+		}
+
+		const bool ntt = (plan.family == transform::EFamily::NTT);
+		_isCtxPlan = true; _ctx_plan = plan;
+		createTransformCPU(gi.getBase(), _n, _t_nthreads, ntt ? "i32" : _t_impl, num_regs, false);
+
+		for (size_t r = 0; r < num_regs; ++r)
+		{
+			_transform->swap(0, r); _transform->setInt(*regs[r]); _transform->swap(0, r);
+		}
+		// the computation of the NTT is exact, the round-off error of a floating-point transform is still sampled
+		_errorSampling = !ntt;
+		_escalated = true;
+		return true;
+	}
+#endif
+
+	// out: reg_0 is 2^exponent, verified by the Gerbicz-Li check at i = 0
+	EReturn prp(const mpz_t & exponent, const int B_GL, const int B_PL, const bool fast_checkpoints, double & testTime, double & validTime)
+	{
+		transform * pTransform = _transform;
+		gint & gi = *_gi;
+
+		int ri = 0, where = 0; double restoredTime = 0;
+		const bool found = readContext(where, fast_checkpoints, ri, restoredTime);
 		if (!found)
 		{
 			ri = 0; restoredTime = 0;
@@ -426,7 +790,7 @@ private:
 			pio::print(ss.str());
 			if (ri == -1)
 			{
-				testTime = 0;
+				testTime = 0; validTime = 0;
 				return EReturn::Success;
 			}
 		}
@@ -436,119 +800,288 @@ private:
 		initPrintProgress(i0, i_start);
 		int dcount = 100;
 
+		// last verified state: u, d(t) and i
+		std::unique_ptr<gint> su(new gint(gi.getSize(), gi.getBase())), sd(new gint(gi.getSize(), gi.getBase()));
+		std::unique_ptr<gint> cu(new gint(gi.getSize(), gi.getBase()));
+		pTransform->swap(0, 1);
+		pTransform->getInt(*sd);
+		pTransform->swap(0, 1);
+		pTransform->getInt(*su);
+		int si = i_start, failures = 0;
+		double stime = chrono.getElapsedTime();
+
+		// On a quit request or a BOINC checkpoint, the test is continued to the next Gerbicz-Li check and the verified state is saved
+		bool flush = false;
+
 		for (int i = i_start; i >= 0; --i)
 		{
-			if (_isBoinc) boincMonitor(0, fast_checkpoints, i, chrono);
+			if (_isBoinc) boincMonitor([&]() { saveVerifiedContext(fast_checkpoints, *su, *sd, si, stime); }, [&]() { flush = true; });
+			if (_quit) flush = true;
 
-			if (_quit)
+			if (flush && (i == si))	// the registers are the last verified state
 			{
-				saveContext(0, fast_checkpoints, i, chrono.getElapsedTime());
-				return EReturn::Aborted;
+				saveVerifiedContext(fast_checkpoints, *su, *sd, si, stime);
+				flush = false;
+				if (_quit) return EReturn::Aborted;
+				if (_isBoinc) boinc_checkpoint_completed();
 			}
 
 			if (i % dcount == 0)
 			{
 				chrono.read(); const double displayTime = chrono.getDisplayTime();
 				if (displayTime >= 10) { dcount = printProgress(displayTime, i); chrono.resetDisplayTime(); }
-				if (!_isBoinc && (chrono.getRecordTime() > 600)) { saveContext(0, fast_checkpoints, i, chrono.getElapsedTime()); chrono.resetRecordTime(); }
 			}
 
+#if !defined(GPU)
+			// one squaring out of 64 is checked
+			const bool sample = _errorSampling && (i % 64 == 0);
+			if (sample) pTransform->setCheckError(true);
+#endif
 			pTransform->squareDup(mpz_tstbit(exponent, mp_bitcnt_t(i)) != 0);
+#if !defined(GPU)
+			if (sample)
+			{
+				pTransform->setCheckError(false);
+				const double error = pTransform->getError();
+				if (error > 0.4)
+				{
+					clearline();
+					std::ostringstream ss; ss << "Round-off error = " << std::setprecision(4) << error << ", switching to a safer implementation." << std::endl;
+					pio::print(ss.str());
+					if (!escalateTransform()) pio::error("no safer implementation is available");
+					pTransform = _transform;
+
+					// some previous squarings may be wrong: restart from the last verified state
+					pTransform->setInt(*sd);
+					pTransform->copy(1, 0);
+					pTransform->setInt(*su);
+					i = si + 1;
+					initPrintProgress(i0, si);
+					chrono.resetRecordTime();
+					continue;
+				}
+			}
+#endif
 			// if (i == static_cast<int>(mpz_sizeinbase(exponent, 2) - 1)) pTransform->add1();	// => invalid
 			// if (i == 0) pTransform->add1();	// => invalid
 
-			if ((i % B_GL == 0) && (i / B_GL != 0))
+			if (i % B_GL == 0)
 			{
-				pTransform->copy(2, 0);
-				pTransform->mul(1);	// d(t)
-				pTransform->copy(1, 0);
-				pTransform->copy(0, 2);
+				chrono.read();
+				// the last stretch is always checked: the result (i = -1) is saved once it is verified
+				if ((i == 0) || flush || (chrono.getRecordTime() >= _glPeriod))
+				{
+					if (i == 0) { clearline(); pio::display("Validating...\r"); }
+					watch vchrono;
+					const EReturn rGL = GLcheck(exponent, B_GL, i, *cu);
+					if (i == 0) validTime = vchrono.getElapsedTime();
+					if (rGL != EReturn::Success)
+					{
+						clearline();
+						std::ostringstream ss; ss << "Gerbicz-Li error checking failed, restarting from the last verified state";
+						pio::error(ss.str());
+						if (++failures > 2) return EReturn::Failed;
+
+						pTransform->setInt(*sd);
+						pTransform->copy(1, 0);
+						pTransform->setInt(*su);
+						i = si + 1;
+						initPrintProgress(i0, si);
+						chrono.resetRecordTime();
+						continue;
+					}
+
+					failures = 0;
+					su.swap(cu);
+					pTransform->swap(0, 1);
+					pTransform->getInt(*sd);
+					pTransform->swap(0, 1);
+					si = i - 1; stime = chrono.getElapsedTime();
+					if ((!_isBoinc || flush) && (i != 0)) saveContext(0, fast_checkpoints, si, stime);
+					chrono.resetRecordTime();
+					if (flush && (i != 0))
+					{
+						flush = false;
+						if (_quit) return EReturn::Aborted;
+						if (_isBoinc) boinc_checkpoint_completed();
+					}
+				}
+				else
+				{
+					pTransform->mulTo(1, 0, 1);	// d(t)
+				}
 			}
 			if ((B_PL != 0) && (i % B_PL == 0))
 			{
-				if (fast_checkpoints) pTransform->copy(3 + size_t(i / B_PL), 0);
+				if (size_t(i / B_PL) < _mem_ckpts) pTransform->copy(3 + size_t(i / B_PL), 0);
 				else
 				{
-					pTransform->getInt(gi);
-					file ckptFile(ckptFilename(size_t(i / B_PL)), "wb", true);
-					gi.write(ckptFile);
-					ckptFile.write_crc32();
+					ckptWriter::job & ckptJob = _writer->acquire();
+					ckptJob.init(ckptFilename(size_t(i / B_PL)), false, true);
+#if defined(GPU)
+					pTransform->getInt(ckptJob.reg(gi.getSize(), gi.getBase()));
+#else
+					// the compute thread copies the register, the inverse transform is done by the writer thread
+					file rawFile(ckptJob.raw(converter(), gi.getSize(), gi.getBase()));
+					pTransform->saveContext(rawFile, 1);
+#endif
+					_writer->submit();
 				}
 			}
 		}
 
-		testTime = chrono.getElapsedTime();
-		saveContext(0, fast_checkpoints, -1, testTime);
+		testTime = chrono.getElapsedTime() - validTime;
+		saveContext(0, fast_checkpoints, -1, chrono.getElapsedTime());
+		if (_isBoinc && flush) boinc_checkpoint_completed();
 		return EReturn::Success;
 	}
 
-	// Gerbicz-Li error checking
-	// in: reg_0 is 2^exponent and reg_1 is d(t)
-	// out: return valid/invalid
-	EReturn GL(const mpz_t & exponent, const int B_GL, double & validTime)
+	// reg_0 = ckpt[i]
+	void loadCheckpoint(const size_t i) const
 	{
-		transform * const pTransform = _transform;
-		gint & gi = *_gi;
+		if (i < _mem_ckpts) _transform->copy(0, 3 + i);
+		else
+		{
+			gint & gi = *_gi;
+			file ckptFile(ckptFilename(i), "rb", true);
+			gi.read(ckptFile);
+			ckptFile.check_crc32();
+			_transform->setInt(gi);
+		}
+	}
+
+	// about 256 MB of multiplicands (at most half of the memory budget if it is set), an extra one is a temporary
+	size_t multiExpSlots() const
+	{
+		const size_t reg_size = (_reg_size != 0) ? _reg_size : (size_t(8) << _n);
+		size_t mem = size_t(256) << 20;
+		if (_memBudget != 0) mem = std::min(mem, (_memBudget << 20) / 2);
+		return std::min(size_t(16), std::max(size_t(3), mem / reg_size) - 1);
+	}
 
-		clearline(); pio::display("Validating...\r");
+	// The multiplicands of the exponentiations are allocated within multiExpSlots(), on GPU within the memory of the device
+	void setMultiplicands(const size_t num_regs)
+	{
+		transform * const pTransform = _transform;
+		pTransform->setMaxMultiplicands(0);
+		_reg_size = pTransform->getMemSize() / num_regs;
+		size_t max_multiplicands = multiExpSlots();
+#if defined(GPU)
+		const size_t max_regs = pTransform->getMaxRegs();
+		max_multiplicands = std::min(max_multiplicands, (max_regs > num_regs) ? max_regs - num_regs : 0);
+#endif
+		pTransform->setMaxMultiplicands(max_multiplicands);
+	}
 
-		watch chrono;
+	// Straus's simultaneous exponentiation: reg_0 = prod_t ckpt[index[t]]^e[t].
+	// A chain of terms shares the squarings, the odd powers of their bases are transformed multiplicands (interleaved sliding windows).
+	// reg_1 is the product of the chains.
+	EReturn multiExp(const std::vector<size_t> & index, const std::vector<mpz_srcptr> & e)
+	{
+		transform * const pTransform = _transform;
+		const size_t T = index.size();
 
-		// d(t + 1) = d(t) * result
-		pTransform->mul(1);
-		pTransform->copy(2, 0);
+		int L = 0;
+		for (mpz_srcptr et : e) L = std::max(L, static_cast<int>(mpz_sizeinbase(et, 2)));
 
-		// d(t)^{2^B}
-		pTransform->copy(0, 1);
-		for (int i = B_GL - 1; i >= 0; --i)
+		const size_t S = multiExpSlots();
+		if (!pTransform->selectMultiplicand(S))
 		{
-			if (_isBoinc) boincMonitor();
-			if (_quit) return EReturn::Aborted;
-			pTransform->squareDup(false);
+			// the slots are not available: the product of the powers, computed with a sliding window
+			for (size_t t = 0; t < T; ++t)
+			{
+				loadCheckpoint(index[t]);
+				mpz_srcptr et = e[t];
+				const int bitsize = (mpz_sgn(et) == 0) ? 0 : static_cast<int>(mpz_sizeinbase(et, 2));
+				powerWindow(0, bitsize, [&](const int i) { return mpz_tstbit(et, mp_bitcnt_t(i)) != 0; });
+				if (t != 0) pTransform->mul(1);
+				pTransform->swap(0, 1);
+
+				if (_isBoinc) boincMonitor();
+				if (_quit) return EReturn::Aborted;
+			}
+			pTransform->swap(0, 1);
+			return EReturn::Success;
 		}
-		pTransform->copy(1, 0);
 
-		mpz_t res; mpz_init_set_ui(res, 0);
-		mpz_t e, t; mpz_init_set(e, exponent); mpz_init(t);
-		while (mpz_sgn(e) != 0)
+		// window size: a chain of S / 2^{w-1} terms costs L squarings, a term L/(w+1) + 2^{w-1} multiplications
+		int w = 1; size_t cost_min = size_t(-1);
+		for (int wi = 1; (wi <= 3) && ((size_t(1) << (wi - 1)) <= S); ++wi)
 		{
-			mpz_mod_2exp(t, e, static_cast<unsigned long int>(B_GL));
-			mpz_add(res, res, t);
-			mpz_div_2exp(e, e, static_cast<unsigned long int>(B_GL));
+			const size_t mi = size_t(1) << (wi - 1), ci = S / mi;
+			const size_t cost = (T + ci - 1) / ci * size_t(L) + T * (size_t(L) / size_t(wi + 1) + ((wi > 1) ? mi : 0));
+			if (cost < cost_min) { cost_min = cost; w = wi; }
 		}
-		mpz_clear(e); mpz_clear(t);
+		const size_t m = size_t(1) << (w - 1), c = S / m;
 
-		// 2^res
-		pTransform->set(1);
-		for (int i = static_cast<int>(mpz_sizeinbase(res, 2)) - 1; i >= 0; --i)
+		for (size_t t0 = 0; t0 < T; t0 += c)
 		{
-			if (_isBoinc) boincMonitor();
-			if (_quit) { mpz_clear(res); return EReturn::Aborted; }
-			pTransform->squareDup(mpz_tstbit(res, mp_bitcnt_t(i)) != 0);
-		}
+			const size_t t1 = std::min(t0 + c, T);
 
-		mpz_clear(res);
+			// multiplicand #(t - t0) * m + j is ckpt[index[t]]^{2j+1}
+			for (size_t t = t0; t < t1; ++t)
+			{
+				const size_t s = (t - t0) * m;
+				loadCheckpoint(index[t]);
+				pTransform->selectMultiplicand(s);
+				pTransform->initMultiplicand(0);
+				if (m > 1)
+				{
+					pTransform->squareDup(false);
+					pTransform->selectMultiplicand(S);
+					pTransform->initMultiplicand(0);
+					for (size_t j = 1; j < m; ++j)
+					{
+						pTransform->selectMultiplicand((j == 1) ? s : S);
+						pTransform->mul();
+						pTransform->selectMultiplicand(s + j);
+						pTransform->initMultiplicand(0);
+					}
+				}
+			}
 
-		// d(t)^{2^B} * 2^res
-		pTransform->mul(1);
+			// the multiplication of a window occurs at the position of its lowest bit
+			std::vector<std::vector<size_t>> muls(static_cast<size_t>(L));
+			for (size_t t = t0; t < t1; ++t)
+			{
+				const size_t s = (t - t0) * m;
+				mpz_srcptr et = e[t];
+				for (int i = static_cast<int>(mpz_sizeinbase(et, 2)) - 1; i >= 0;)
+				{
+					if (mpz_tstbit(et, mp_bitcnt_t(i)) == 0) { --i; continue; }
+					int l = std::max(i - w + 1, 0);
+					while (mpz_tstbit(et, mp_bitcnt_t(l)) == 0) ++l;
+					size_t u = 0;
+					for (int j = i; j >= l; --j) u = 2 * u + size_t(mpz_tstbit(et, mp_bitcnt_t(j)));
+					muls[size_t(l)].push_back(s + u / 2);
+					i = l - 1;
+				}
+			}
 
-		// d(t)^{2^B} * 2^res ?= d(t + 1)
-		pTransform->getInt(gi);
-		const uint64_t h1 = gi.gethash64();
-		pTransform->copy(0, 2);
-		pTransform->getInt(gi);
-		const uint64_t h2 = gi.gethash64();
+			pTransform->set(1);
+			bool first = true;
+			for (int i = L - 1; i >= 0; --i)
+			{
+				if (!first) pTransform->squareDup(false);
+				for (const size_t s : muls[size_t(i)]) { pTransform->selectMultiplicand(s); pTransform->mul(); first = false; }
 
-		const bool success = (h1 == h2);
+				if (_isBoinc) boincMonitor();
+				if (_quit) { pTransform->selectMultiplicand(0); return EReturn::Aborted; }
+			}
+			pTransform->selectMultiplicand(0);
 
-		validTime = chrono.getElapsedTime();
-		return success ? EReturn::Success : EReturn::Failed;
+			if (t0 != 0) pTransform->mul(1);
+			pTransform->swap(0, 1);
+		}
+		pTransform->swap(0, 1);
+
+		return EReturn::Success;
 	}
 
 	// (Pietrzak-Li proof generation
 	// in: ckpt[i]
 	// out: proof file, proof key
-	EReturn PL(const int depth, const bool fast_checkpoints, double & proofTime, uint64_t & pkey)
+	EReturn PL(const int depth, double & proofTime, uint64_t & pkey)
 	{
 		transform * const pTransform = _transform;
 		gint & gi = *_gi;
@@ -562,8 +1095,10 @@ private:
 		proofFile.write(reinterpret_cast<const char *>(&version), sizeof(version));
 		proofFile.write(reinterpret_cast<const char *>(&depth), sizeof(depth));
 
+		_writer->wait();
+
 		// mu[0] = ckpt[0]
-		if (fast_checkpoints)
+		if (_mem_ckpts != 0)
 		{
 			pTransform->copy(0, 3 + 0);
 			pTransform->getInt(gi);
@@ -579,7 +1114,7 @@ private:
 		const uint32_t q = gi.gethash32();
 		pTransform->setInt(gi);
 		power(0, q);
-		pTransform->copy(2, 0);
+		pTransform->swap(0, 2);
 
 		const size_t L = size_t(1) << depth;
 		mpz_t * const w = new mpz_t[L / 2]; for (size_t i = 0; i < L / 2; ++i) mpz_init(w[i]);
@@ -587,46 +1122,51 @@ private:
 
 // size_t s = 0;	// complexity
 
+		const bool straus = pTransform->selectMultiplicand(multiExpSlots());
+		pTransform->selectMultiplicand(0);
+
 		for (int k = 1; k <= depth; ++k)
 		{
 			const size_t i = size_t(1) << (depth - k);
 
-			// mu[k] = ckpt[i]^w[0]
-			if (fast_checkpoints) pTransform->copy(0, 3 + i);
-			else
+			if (straus)
 			{
-				file ckptFile(ckptFilename(i), "rb", true);
-				gi.read(ckptFile);
-				ckptFile.check_crc32();
-				pTransform->setInt(gi);
+				// mu[k] = prod_j ckpt[i + 2 * j]^w[j]
+				std::vector<size_t> ckpt; std::vector<mpz_srcptr> e;
+				for (size_t j = 0; j < L / 2; j += i) { ckpt.push_back(i + 2 * j); e.push_back(w[j]); }
+				if (multiExp(ckpt, e) == EReturn::Aborted)
+				{
+					for (size_t i = 0; i < L / 2; ++i) mpz_clear(w[i]);
+					delete[] w;
+					return EReturn::Aborted;
+				}
 			}
-			powerz(0, w[0]);
+			else
+			{
+				// mu[k] = ckpt[i]^w[0]
+				loadCheckpoint(i);
+				powerz(0, w[0]);
 // s += mpz_sizeinbase(w[0], 2);
-			pTransform->copy(1, 0);
+				pTransform->swap(0, 1);
 
-			for (size_t j = i; j < L / 2; j += i)
-			{
-				// mu[k] *= ckpt[i + 2 * j]^w[j]
-				if (fast_checkpoints) pTransform->copy(0, 3 + i + 2 * j);
-				else
+				for (size_t j = i; j < L / 2; j += i)
 				{
-					file ckptFile(ckptFilename(i + 2 * j), "rb", true);
-					gi.read(ckptFile);
-					ckptFile.check_crc32();
-					pTransform->setInt(gi);
-				}
-				powerz(0, w[j]);
+					// mu[k] *= ckpt[i + 2 * j]^w[j]
+					loadCheckpoint(i + 2 * j);
+					powerz(0, w[j]);
 // s += mpz_sizeinbase(w[j], 2);
-				pTransform->mul(1);
-				pTransform->copy(1, 0);
+					pTransform->mul(1);
+					pTransform->swap(0, 1);
 
-				if (_isBoinc) boincMonitor();
-				if (_quit)
-				{
-					for (size_t i = 0; i < L / 2; ++i) mpz_clear(w[i]);
-					delete[] w;
-					return EReturn::Aborted;
+					if (_isBoinc) boincMonitor();
+					if (_quit)
+					{
+						for (size_t i = 0; i < L / 2; ++i) mpz_clear(w[i]);
+						delete[] w;
+						return EReturn::Aborted;
+					}
 				}
+				pTransform->swap(0, 1);
 			}
 // std::cout << k << ": " << s << ", " << 32 * k * (1 << (k - 1))<< std::endl;
 			pTransform->getInt(gi);
@@ -635,7 +1175,7 @@ private:
 			// v1 = v1 * mu[k]^w[k]
 			power(0, q);
 			pTransform->mul(2);
-			pTransform->copy(2, 0);
+			pTransform->swap(0, 2);
 
 			if (i > 1)
 			{
@@ -656,7 +1196,7 @@ private:
 		delete[] w;
 
 		// pkey = hash64(v1);
-		pTransform->copy(0, 2);
+		pTransform->swap(0, 2);
 		pTransform->getInt(gi);
 		pkey = gi.gethash64();
 
@@ -664,18 +1204,69 @@ private:
 		return EReturn::Success;
 	}
 
+	// time of a squaring and of a multiplication
+	void measureOps(double & sqrTime, double & mulTime) const
+	{
+		transform * const pTransform = _transform;
+		gint & gi = *_gi;
+		static const int count = 64;
+
+		pTransform->set(1);
+		for (int i = 0; i < 8; ++i) pTransform->squareDup(true);
+		pTransform->getInt(gi);
+
+		watch chrono;
+		for (int i = 0; i < count; ++i) pTransform->squareDup(false);
+		pTransform->getInt(gi);	// synchronization
+		sqrTime = chrono.getElapsedTime() / count;
+
+		pTransform->initMultiplicand(0);
+		watch chrono_m;
+		for (int i = 0; i < count; ++i) pTransform->mul();
+		pTransform->getInt(gi);
+		mulTime = chrono_m.getElapsedTime() / count;
+	}
+
+	// The test is E squarings, the level k of the proof is 2^{k-1} exponentiations to about 32k bits,
+	// the server and the checker compute about E / 2^depth squarings each.
+	// The checkpoints (2^depth packed digit vectors) must fit in the disk budget.
+	int proofDepth(const uint32_t b, const double sqrTime, const double mulTime, const bool straus,
+				   double & testTime, double & proofTime, double & serverTime) const
+	{
+		const size_t storage_max = _diskBudget << 20;
+		static const int depth_max = 12;
+
+		const double E = std::ldexp(std::log2(double(b)), static_cast<int>(_n));
+		const size_t ckptSize = (size_t(ilog2_32(b - 1) + 1) << _n) / 8;
+		const size_t S = multiExpSlots();
+
+		int depth = 1; double cost_min = 0, proof = 0;
+		for (int d = 1; (d <= depth_max) && ((size_t(1) << d) * ckptSize <= storage_max); ++d)
+		{
+			const size_t T = size_t(1) << (d - 1);
+			const double L = 32.0 * d, chains = straus ? double((T + S - 1) / S) : double(T);
+			proof += chains * L * sqrTime + T * (L / 2) * mulTime;
+			const double cost = proof + 2 * std::ldexp(E, -d) * sqrTime;
+			if ((d == 1) || (cost < cost_min)) { cost_min = cost; depth = d; proofTime = proof; }
+		}
+
+		testTime = E * sqrTime;
+		serverTime = std::ldexp(E, -depth) * sqrTime;
+		return depth;
+	}
+
 	EReturn quick(const mpz_t & exponent, double & testTime, double & validTime, bool & isPrp, uint64_t & res64, uint64_t & old64)
 	{
 		const int B_GL = B_GerbiczLi(mpz_sizeinbase(exponent, 2));
 
-		const EReturn rPrp = prp(exponent, B_GL, 0, false, testTime);
+		const EReturn rPrp = prp(exponent, B_GL, 0, false, testTime, validTime);
 		if (rPrp != EReturn::Success) return rPrp;
 		{
 			gint & gi = *_gi;
 			_transform->getInt(gi);
 			isPrp = gi.isOne(res64, old64);
 		}
-		return GL(exponent, B_GL, validTime);
+		return EReturn::Success;
 	}
 
 	EReturn proof(const mpz_t & exponent, const int depth, const bool fast_checkpoints, double & testTime, double & validTime, double & proofTime,
@@ -684,16 +1275,14 @@ private:
 		const size_t esize = mpz_sizeinbase(exponent, 2);
 		const int B_GL = B_GerbiczLi(esize), B_PL = B_PietrzakLi(esize, depth);
 
-		const EReturn rPrp = prp(exponent, B_GL, B_PL, fast_checkpoints, testTime);
+		const EReturn rPrp = prp(exponent, B_GL, B_PL, fast_checkpoints, testTime, validTime);
 		if (rPrp != EReturn::Success) return rPrp;
 		{
 			gint & gi = *_gi;
 			_transform->getInt(gi);
 			isPrp = gi.isOne(res64, old64);
 		}
-		const EReturn rGL = GL(exponent, B_GL, validTime);
-		if (rGL != EReturn::Success) return rGL;
-		return PL(depth, fast_checkpoints, proofTime, pkey);
+		return PL(depth, proofTime, pkey);
 	}
 
 	static uint32_t rand32(const uint32_t rmin, const uint32_t rmax) { return (static_cast<uint32_t>(std::rand()) % (rmax - rmin)) + rmin; }
@@ -738,12 +1327,12 @@ private:
 			// v1 = v1 * mu[k]^w[k]
 			power(0, q);
 			pTransform->mul(1);
-			pTransform->copy(1, 0);
+			pTransform->swap(0, 1);
 
 			// v2 = v2^w[k] * mu[k]
 			power(2, q);
 			pTransform->mul(3);
-			pTransform->copy(2, 0);
+			pTransform->swap(0, 2);
 
 			const size_t i = size_t(1) << (depth - k);
 			for (size_t j = 0; j < L; j += 2 * i) mpz_mul_ui(w[i + j], w[j], q);
@@ -815,13 +1404,173 @@ private:
 		return EReturn::Success;
 	}
 
-	EReturn check(double & time, uint64_t & ckey)
+#if !defined(GPU)
+	// The context of the 2^p2 chain contains the digit vectors of x and d(t): it doesn't depend on the thread split.
+	// It is read and written by the worker thread: the error is returned into errorStr and reported by the main thread.
+	bool readCheckContext(transform * const pTransform, gint & gi, int & i, double & elapsedTime, std::string & errorStr) const
+	{
+		const std::string ctxFile = checkContextFilename();
+		struct stat s;
+		if (stat(ctxFile.c_str(), &s) != 0) return false;
+
+		file contextFile(ctxFile, "rb", errorStr);
+		if (!contextFile.exists()) return false;
+
+		int version = 0, where = 0; uint32_t b = 0, n = 0;
+		if (!contextFile.read(reinterpret_cast<char *>(&version), sizeof(version)) || (version != 2)) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&where), sizeof(where)) || (where != 3)) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&i), sizeof(i))) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&elapsedTime), sizeof(elapsedTime))) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&b), sizeof(b))) return false;
+		if (!contextFile.read(reinterpret_cast<char *>(&n), sizeof(n))) return false;
+		if ((b != gi.getBase()) || (n != _n)) return false;
+		for (size_t r = 0; r < 2; ++r)
+		{
+			gi.read(contextFile);
+			pTransform->swap(0, r);
+			pTransform->setInt(gi);
+			pTransform->swap(0, r);
+		}
+		return contextFile.check_crc32();
+	}
+
+	void saveCheckContext(transform * const pTransform, gint & gi, const int i, const double elapsedTime, std::string & errorStr) const
+	{
+		const std::string ctxFile = checkContextFilename(), newCtxFile = ctxFile + ".new";
+		{
+			file contextFile(newCtxFile, "wb", errorStr);
+			if (!contextFile.exists()) return;
+			const int version = 2, where = 3; const uint32_t b = gi.getBase(), n = _n;
+			if (!contextFile.write(reinterpret_cast<const char *>(&version), sizeof(version))) return;
+			if (!contextFile.write(reinterpret_cast<const char *>(&where), sizeof(where))) return;
+			if (!contextFile.write(reinterpret_cast<const char *>(&i), sizeof(i))) return;
+			if (!contextFile.write(reinterpret_cast<const char *>(&elapsedTime), sizeof(elapsedTime))) return;
+			if (!contextFile.write(reinterpret_cast<const char *>(&b), sizeof(b))) return;
+			if (!contextFile.write(reinterpret_cast<const char *>(&n), sizeof(n))) return;
+			for (size_t r = 0; r < 2; ++r)
+			{
+				pTransform->swap(0, r);
+				pTransform->getInt(gi);
+				pTransform->swap(0, r);
+				gi.write(contextFile);
+			}
+			contextFile.write_crc32();
+		}
+		if (!errorStr.empty()) return;
+		if (std::rename(newCtxFile.c_str(), ctxFile.c_str()) != 0) errorStr = "cannot save context";
+	}
+
+	// 2^p2 and its Gerbicz-Li test, computed by a worker thread on a second transform (check mode).
+	// The thread is silent, the progress of the v2^{2^B} chain is displayed by the main thread. pio is not thread-safe:
+	// the first file error is returned into errorStr.
+	EReturn checkPow2(const size_t nthreads, const std::string & impl, const bool checkError, mpz_srcptr p2e,
+					  gint & result, double & error, const std::atomic<bool> & stop, std::string & errorStr)
+	{
+		if (nthreads > 1) omp_set_num_threads(static_cast<int>(nthreads));	// OpenMP settings are per thread
+		std::string ttype;
+		transform * const pTransform = transform::create_cpu(result.getBase(), _n, nthreads, impl, _kind, 3, checkError, ttype);
+		if ((_pool != EPool::OpenMP) && (nthreads > 1))
+		{
+			pTransform->setThreadPool((_pool == EPool::Spin) ? threadPool::EWait::Spin : threadPool::EWait::Park);
+		}
+		gint gi(result.getSize(), result.getBase());
+
+		const EReturn ret = checkPow2(pTransform, p2e, gi, result, stop, errorStr);
+		error = pTransform->getError();
+		delete pTransform;
+		return ret;
+	}
+
+	EReturn checkPow2(transform * const pTransform, mpz_srcptr p2e, gint & gi, gint & result, const std::atomic<bool> & stop, std::string & errorStr)
+	{
+		const int p2size = static_cast<int>(mpz_sizeinbase(p2e, 2)), GL = B_GerbiczLi(static_cast<size_t>(p2size));
+
+		int ri = 0; double restoredTime = 0;
+		const bool found = readCheckContext(pTransform, gi, ri, restoredTime, errorStr);
+		if (!found)
+		{
+			pTransform->set(1);
+			pTransform->copy(1, 0);	// d(t)
+		}
+
+		watch chrono(found ? restoredTime : 0);
+		for (int i = found ? ri : p2size - 1; i >= 0; --i)
+		{
+			if (_quit || stop)
+			{
+				if (_quit) saveCheckContext(pTransform, gi, i, chrono.getElapsedTime(), errorStr);
+				return EReturn::Aborted;
+			}
+
+			if (i % 100 == 0)
+			{
+				chrono.read();
+				if (chrono.getRecordTime() > 600) { saveCheckContext(pTransform, gi, i, chrono.getElapsedTime(), errorStr); chrono.resetRecordTime(); }
+			}
+
+			pTransform->squareDup(mpz_tstbit(p2e, mp_bitcnt_t(i)) != 0);
+
+			if ((i % GL == 0) && (i / GL != 0))
+			{
+				pTransform->mulTo(1, 0, 1);	// d(t)
+			}
+		}
+
+		pTransform->getInt(result);
+
+		// d(t + 1) = d(t) * result
+		pTransform->mul(1);
+		pTransform->swap(0, 2);
+
+		// d(t)^{2^GL}
+		pTransform->swap(0, 1);
+		for (int i = GL - 1; i >= 0; --i)
+		{
+			if (_quit || stop) return EReturn::Aborted;
+			pTransform->squareDup(false);
+		}
+		pTransform->swap(0, 1);
+
+		mpz_t p2, res, t; mpz_init_set(p2, p2e); mpz_init_set_ui(res, 0); mpz_init(t);
+		while (mpz_sgn(p2) != 0)
+		{
+			mpz_mod_2exp(t, p2, static_cast<unsigned long int>(GL));
+			mpz_add(res, res, t);
+			mpz_div_2exp(p2, p2, static_cast<unsigned long int>(GL));
+		}
+		mpz_clear(p2); mpz_clear(t);
+
+		// 2^res
+		pTransform->set(1);
+		for (int i = static_cast<int>(mpz_sizeinbase(res, 2)) - 1; i >= 0; --i)
+		{
+			if (_quit || stop) { mpz_clear(res); return EReturn::Aborted; }
+			pTransform->squareDup(mpz_tstbit(res, mp_bitcnt_t(i)) != 0);
+		}
+
+		mpz_clear(res);
+
+		// d(t)^{2^GL} * 2^res ?= d(t + 1)
+		pTransform->mul(1);
+		pTransform->getInt(gi);
+		const uint64_t h1 = gi.gethash64();
+		pTransform->swap(0, 2);
+		pTransform->getInt(gi);
+		const uint64_t h2 = gi.gethash64();
+
+		return (h1 == h2) ? EReturn::Success : EReturn::Failed;
+	}
+#endif
+
+	// If nthreads2 != 0, the 2^p2 chain is computed concurrently by a worker thread, error2 is its round-off error
+	EReturn check(double & time, uint64_t & ckey, double & error2, const size_t nthreads2, const std::string & impl, const bool checkError)
 	{
 		transform * const pTransform = _transform;
 		gint & gi = *_gi;
 
 		int ri = 0; double restoredTime = 0;
-		const bool found = readContext(1, false, ri, restoredTime);
+		int where = (nthreads2 != 0) ? 2 : 1;
+		const bool found = readContext(where, false, ri, restoredTime);
 		if (!found)
 		{
 			ri = 0; restoredTime = 0;
@@ -844,14 +1593,43 @@ private:
 		}
 		const int p2size = static_cast<int>(mpz_sizeinbase(p2, 2));
 
+		// The layouts are identical during the v2^{2^B} chain. After it, a sequential context is resumed sequentially
+		// and if a concurrent context is resumed with one thread, the 2^p2 chain is computed again.
+		bool concurrent = (nthreads2 != 0);
+		if (found && (ri < p2size) && (where == 1)) concurrent = false;
+		const bool restart = found && (ri < p2size) && (where == 2) && !concurrent;
+		where = concurrent ? 2 : 1;
+
 		// Gerbicz test for v2^{2^B} and Gerbicz-Li test for 2^p2
 		const int L = B_GerbiczLi(static_cast<size_t>(B)), GL = B_GerbiczLi(static_cast<size_t>(p2size));
 
 		watch chrono(found ? restoredTime : 0);
-		const int i0 = p2size + B - 1;
-		initPrintProgress(i0, found ? ri : i0);
+		const int i0 = p2size + B - 1, ip = concurrent ? p2size : 0;
+		initPrintProgress(i0 - ip, (found ? ri : i0) - ip);
 		int dcount = 100;
 
+		std::thread worker;
+		gint result(gi.getSize(), gi.getBase());
+		EReturn wret = EReturn::Failed;
+		std::atomic<bool> stop(false);
+		std::string werror;	// the error of the worker thread is reported after the join
+		auto join = [&](const bool abort)
+		{
+			stop = abort;
+			if (worker.joinable()) worker.join();
+			if (!werror.empty()) { pio::error(werror); werror.clear(); }
+		};
+#if !defined(GPU)
+		if (concurrent)
+		{
+			std::ostringstream ss; ss << "Checking 2^p2 concurrently, " << nthreads2 << " thread(s)." << std::endl;
+			pio::print(ss.str());
+			worker = std::thread([&] { wret = checkPow2(nthreads2, impl, checkError, p2, result, error2, stop, werror); });
+		}
+#else
+		(void)impl; (void)checkError; (void)error2;
+#endif
+
 		// v2 = v2^{2^B}
 		if (!found || (ri >= p2size))
 		{
@@ -862,29 +1640,26 @@ private:
 			}
 			for (int i = found ? ri : i0; i >= p2size; --i)
 			{
-				if (_isBoinc) boincMonitor(1, false, i, chrono);
+				if (_isBoinc) boincMonitor(where, false, i, chrono);
 
 				if (_quit)	// || (i == p2size + B/2))	// test context
 				{
-					saveContext(1, false, i, chrono.getElapsedTime());
-					mpz_clear(p2);
+					saveContext(where, false, i, chrono.getElapsedTime());
+					join(true); mpz_clear(p2);
 					return EReturn::Aborted;
 				}
 
 				if (i % dcount == 0)
 				{
 					chrono.read(); const double displayTime = chrono.getDisplayTime();
-					if (displayTime >= 10) { dcount = printProgress(displayTime, i); chrono.resetDisplayTime(); }
-					if (!_isBoinc && (chrono.getRecordTime() > 600)) { saveContext(1, false, i, chrono.getElapsedTime()); chrono.resetRecordTime(); }
+					if (displayTime >= 10) { dcount = printProgress(displayTime, i - ip); chrono.resetDisplayTime(); }
+					if (!_isBoinc && (chrono.getRecordTime() > 600)) { saveContext(where, false, i, chrono.getElapsedTime()); chrono.resetRecordTime(); }
 				}
 
 				const int j = i0 - i;
 				if ((j % L == 0) && (j != 0))
 				{
-					pTransform->copy(2, 0);
-					pTransform->mul(1);	// d(t) = d(t - 1) * u(t * L)
-					pTransform->copy(1, 0);
-					pTransform->copy(0, 2);
+					pTransform->mulTo(1, 0, 1);	// d(t) = d(t - 1) * u(t * L)
 				}
 
 				pTransform->squareDup(false);
@@ -900,23 +1675,23 @@ private:
 				for (int i = L - (B % L); i > 0; --i)
 				{
 					if (_isBoinc) boincMonitor();
-					if (_quit) { mpz_clear(p2); return EReturn::Aborted; }
+					if (_quit) { join(true); mpz_clear(p2); return EReturn::Aborted; }
 					pTransform->squareDup(false);
 				}
 			}
 			// d(t + 1) = d(t) * u((t + 1) * L)
 			pTransform->mul(1);
-			pTransform->copy(3, 0);
+			pTransform->swap(0, 3);
 
 			// d(t)^{2^L}
-			pTransform->copy(0, 1);
+			pTransform->swap(0, 1);
 			for (int i = L; i > 0; --i)
 			{
 				if (_isBoinc) boincMonitor();
-				if (_quit) { mpz_clear(p2); return EReturn::Aborted; }
+				if (_quit) { join(true); mpz_clear(p2); return EReturn::Aborted; }
 				pTransform->squareDup(false);
 			}
-			pTransform->copy(1, 0);
+			pTransform->swap(0, 1);
 
 			// u(0) * d(t)^{2^L}
 			pTransform->setInt(gi);
@@ -925,15 +1700,35 @@ private:
 			// u(0) * d(t)^{2^L} ?= d(t + 1)
 			pTransform->getInt(gi);
 			const uint64_t h1 = gi.gethash64();
-			pTransform->copy(0, 3);
+			pTransform->swap(0, 3);
 			pTransform->getInt(gi);
 			const uint64_t h2 = gi.gethash64();
 
-			if (h1 != h2) { mpz_clear(p2); return EReturn::Failed; }
+			if (h1 != h2) { join(true); mpz_clear(p2); return EReturn::Failed; }
+
+			if (concurrent) saveContext(where, false, p2size - 1, chrono.getElapsedTime());
+		}
+
+		if (concurrent)
+		{
+			join(false); mpz_clear(p2);
+			if (wret != EReturn::Success) return wret;
+
+			// v1' = v2 * 2^p2
+			pTransform->setInt(result);
+			pTransform->mul(2);
+
+			// ckey = hash64(v1')
+			pTransform->getInt(gi);
+			ckey = gi.gethash64();
+
+			time = chrono.getElapsedTime();
+			return EReturn::Success;
 		}
 
+
 		// 2^p2
-		if (!found || (ri >= p2size))
+		if (!found || (ri >= p2size) || restart)
 		{
 			pTransform->set(1);
 			pTransform->copy(1, 0);	// d(t)
@@ -962,10 +1757,7 @@ private:
 
 			if ((i % GL == 0) && (i / GL != 0))
 			{
-				pTransform->copy(3, 0);
-				pTransform->mul(1);	// d(t)
-				pTransform->copy(1, 0);
-				pTransform->copy(0, 3);
+				pTransform->mulTo(1, 0, 1);	// d(t)
 			}
 		}
 
@@ -979,19 +1771,19 @@ private:
 		ckey = gi.gethash64();
 
 		// d(t + 1) = d(t) * result
-		pTransform->copy(0, 3);
+		pTransform->swap(0, 3);
 		pTransform->mul(1);
-		pTransform->copy(2, 0);
+		pTransform->swap(0, 2);
 
 		// d(t)^{2^GL}
-		pTransform->copy(0, 1);
+		pTransform->swap(0, 1);
 		for (int i = GL - 1; i >= 0; --i)
 		{
 			if (_isBoinc) boincMonitor();
 			if (_quit) { mpz_clear(p2); return EReturn::Aborted; }
 			pTransform->squareDup(false);
 		}
-		pTransform->copy(1, 0);
+		pTransform->swap(0, 1);
 
 		mpz_t res, t; mpz_init_set_ui(res, 0); mpz_init(t);
 		while (mpz_sgn(p2) != 0)
@@ -1019,7 +1811,7 @@ private:
 		// d(t)^{2^GL} * 2^res ?= d(t + 1)
 		pTransform->getInt(gi);
 		const uint64_t h1 = gi.gethash64();
-		pTransform->copy(0, 2);
+		pTransform->swap(0, 2);
 		pTransform->getInt(gi);
 		const uint64_t h2 = gi.gethash64();
 
@@ -1112,8 +1904,431 @@ private:
 		return qret;
 	}
 
+	// b classes of the benchmarks: 0 is small, 2 is about the limit of the transforms, 1 is the geometric mean
+	static uint32_t benchBase(const uint32_t n, const int bclass)
+	{
+		static constexpr uint32_t bm[22 - 15 + 1] = { 350000000, 200000000, 150000000, 20000000, 6000000, 2000000, 1000000, 300000 };
+		const uint32_t b_large = bm[n - 15];
+		if (bclass == 0) return 1000;
+		if (bclass == 1) return static_cast<uint32_t>(std::sqrt(1000.0 * b_large)) & ~uint32_t(1);
+		return b_large;
+	}
+
+#if !defined(GPU)
+	// powers of two and the number of logical cores (at most max_threads)
+	static std::vector<size_t> threadCounts()
+	{
+		std::vector<size_t> threads;
+		const size_t nprocs = std::min(size_t(omp_get_num_procs()), max_threads);
+		for (size_t t = 1; t < nprocs; t *= 2) threads.push_back(t);
+		threads.push_back(nprocs);
+		return threads;
+	}
+#endif
+
+	struct benchResult
+	{
+		std::string impl, kind, bclass, pool;
+		size_t nthreads, memsize;
+		uint32_t n, b;
+		double median, stddev;	// ms/bit
+		size_t repeats, iterations;
+		bool valid;
+	};
+
+	// A configuration is validated with a short test, warmed up and timed: the median and the standard deviation of the repeats
+	benchResult benchConfig(const uint32_t b, const uint32_t n, const std::string & bclass, const size_t device, const size_t nthreads, const std::string & impl)
+	{
+		static const size_t repeats = 5;
+		static const double repeatTime = 0.2;
+
+#if defined(GPU)
+		(void)nthreads;
+		createTransformGPU(b, n, device, 3, false, false);
+#else
+		(void)device;
+		createTransformCPU(b, n, nthreads, impl, 3, false, false, false);
+#endif
+		transform * const pTransform = _transform;
+		_n = n;
+		_gi = new gint(size_t(1) << n, b);
+		gint & gi = *_gi;
+
+		benchResult r;
+		r.impl = impl; r.kind = pTransform->getKindName(); r.bclass = bclass;
+		r.pool = (_pool == EPool::Spin) ? "spin" : ((_pool == EPool::Park) ? "park" : "openmp");
+		r.nthreads = nthreads; r.n = n; r.b = b;
+		r.median = r.stddev = 0; r.repeats = 0; r.iterations = 0;
+		r.memsize =
+#if defined(GPU)
+			pTransform->getMemSize();
+#else
+			pTransform->getCacheSize();
+#endif
+
+		mpz_t exponent; mpz_init(exponent); mpz_ui_pow_ui(exponent, 3, 20);
+		double testTime = 0, validTime = 0; bool isPrp = false; uint64_t res64 = 0, old64 = 0;
+		r.valid = (quick(exponent, testTime, validTime, isPrp, res64, old64) == EReturn::Success);
+		mpz_clear(exponent);
+		clearContext();
+
+		if (r.valid)
+		{
+			// warm-up and calibration: a repeat is about repeatTime seconds
+			size_t count = 8;
+			while (true)
+			{
+				watch chrono;
+				for (size_t i = 0; i < count; ++i) pTransform->squareDup(false);
+				pTransform->getInt(gi);	// synchronization
+				const double t = chrono.getElapsedTime();
+				if ((t >= repeatTime / 4) || _quit) { count = std::max(size_t(8), static_cast<size_t>(count * repeatTime / t)); break; }
+				count *= 4;
+			}
+
+			std::vector<double> tv;
+			for (size_t k = 0; (k < repeats) && !_quit; ++k)
+			{
+				watch chrono;
+				for (size_t i = 0; i < count; ++i) pTransform->squareDup(false);
+				pTransform->getInt(gi);
+				tv.push_back(chrono.getElapsedTime() / count * 1e3);
+			}
+
+			if (!tv.empty())
+			{
+				std::sort(tv.begin(), tv.end());
+				const size_t m = tv.size();
+				r.median = (m % 2 != 0) ? tv[m / 2] : (tv[m / 2 - 1] + tv[m / 2]) / 2;
+				double mean = 0; for (const double t : tv) mean += t; mean /= m;
+				double var = 0; for (const double t : tv) var += (t - mean) * (t - mean);
+				r.stddev = (m > 1) ? std::sqrt(var / (m - 1)) : 0;
+				r.repeats = m; r.iterations = count;
+			}
+		}
+
+		delete _gi; _gi = nullptr;
+		deleteTransform();
+		return r;
+	}
+
+	static void writeBenchResults(const std::string & filename, const std::vector<benchResult> & results)
+	{
+		const bool csv = (filename.size() >= 4) && (filename.substr(filename.size() - 4) == ".csv");
+		std::ostringstream ss; ss << std::setprecision(6);
+		if (csv)
+		{
+			ss << "impl,kind,threads,pool,n,class,b,ms_per_bit,stddev,repeats,iterations,data_size_mb,valid" << std::endl;
+			for (const benchResult & r : results)
+			{
+				ss << r.impl << "," << r.kind << "," << r.nthreads << "," << r.pool << "," << r.n << "," << r.bclass << "," << r.b << ","
+				   << r.median << "," << r.stddev << "," << r.repeats << "," << r.iterations << "," << r.memsize / (1024 * 1024.0) << ","
+				   << (r.valid ? "true" : "false") << std::endl;
+			}
+		}
+		else
+		{
+			ss << "{" << std::endl << "  \"results\": [" << std::endl;
+			for (size_t i = 0; i < results.size(); ++i)
+			{
+				const benchResult & r = results[i];
+				ss << "    { \"impl\": \"" << r.impl << "\", \"kind\": \"" << r.kind << "\", \"threads\": " << r.nthreads
+				   << ", \"pool\": \"" << r.pool << "\", \"n\": " << r.n << ", \"class\": \"" << r.bclass << "\", \"b\": " << r.b
+				   << ", \"ms_per_bit\": " << r.median << ", \"stddev\": " << r.stddev << ", \"repeats\": " << r.repeats
+				   << ", \"iterations\": " << r.iterations << ", \"data_size_mb\": " << r.memsize / (1024 * 1024.0)
+				   << ", \"valid\": " << (r.valid ? "true" : "false") << " }" << ((i + 1 < results.size()) ? "," : "") << std::endl;
+			}
+			ss << "  ]" << std::endl << "}" << std::endl;
+		}
+
+		file outFile(filename, "w", true);
+		outFile.print(ss.str().c_str());
+	}
+
+public:
+	// Benchmark suite: implementations x thread counts x n x b classes (small, medium, large), the results are written to a JSON or CSV file.
+	// If n_arg, nthreads_arg or impl_arg is set, the corresponding loop is restricted to this value.
+	EReturn benchSuite(const std::string & filename, const uint32_t n_arg, const size_t device, const size_t nthreads_arg, const std::string & impl_arg)
+	{
+		std::vector<std::string> impls;
+#if defined(GPU)
+		impls.push_back("ocl");
+		std::vector<size_t> threads = { 1 };
+		(void)nthreads_arg; (void)impl_arg;
+#else
+		if (!impl_arg.empty()) impls.push_back(impl_arg);
+		else
+		{
+			std::istringstream iss(transform::implementations());
+			std::string s; while (iss >> s) impls.push_back(s);
+		}
+		const std::vector<size_t> threads = (nthreads_arg != 0) ? std::vector<size_t>(1, nthreads_arg) : threadCounts();
+#endif
+
+		const bool emptyMainFilename = _mainFilename.empty();
+		if (emptyMainFilename) _mainFilename = "bench";
+
+		// if a thread pool is selected, OpenMP and the pool are measured at each thread count: the results compare their scaling
+		const EPool pool_arg = _pool;
+		std::vector<EPool> pools(1, EPool::OpenMP);
+		if (pool_arg != EPool::OpenMP) pools.push_back(pool_arg);
+
+		std::vector<benchResult> results;
+		for (const std::string & impl : impls)
+		{
+			for (const size_t nt : threads)
+			{
+				for (const EPool pool : pools)
+				{
+					if ((pool != EPool::OpenMP) && (nt == 1)) continue;	// the pool is not used by a single thread
+					_pool = pool;
+
+					for (uint32_t n = 15; n <= 22; ++n)
+					{
+						if ((n_arg != 0) && (n != n_arg)) continue;
+
+						const std::pair<std::string, uint32_t> bclasses[3] = { { "small", benchBase(n, 0) }, { "medium", benchBase(n, 1) }, { "large", benchBase(n, 2) } };
+
+						for (const auto & bc : bclasses)
+						{
+							if (_quit) break;
+							const benchResult r = benchConfig(bc.second, n, bc.first, device, nt, (impl == "ocl") ? "" : impl);
+							results.push_back(r);
+							results.back().impl = impl;
+
+							clearline();
+							std::ostringstream ss; ss << impl << " (" << r.kind << "), " << nt << " thread(s)";
+							if (pools.size() > 1) ss << " (" << r.pool << ")";
+							ss << ", " << gfn(r.b, n);
+							if (!r.valid) ss << ": test failed!";
+							else ss << ": " << std::setprecision(3) << r.median << " ms/bit, stddev = " << r.stddev << ", data size: " << r.memsize / (1024 * 1024.0) << " MB.";
+							ss << std::endl; pio::print(ss.str());
+						}
+					}
+				}
+			}
+		}
+		_pool = pool_arg;
+
+		if (emptyMainFilename) _mainFilename.clear();
+
+		writeBenchResults(filename, results);
+		return _quit ? EReturn::Aborted : EReturn::Success;
+	}
+
+private:
+
+#if !defined(GPU)
+	static std::string tuneFilename() { return "genefer.tune"; }
+
+	static std::string cpuModel()
+	{
+		std::string model;
+#if defined(__x86_64) || defined(__i386__)
+		uint32_t brand[12] = { 0 };
+		if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004)
+		{
+			for (uint32_t i = 0; i < 3; ++i) __get_cpuid(0x80000002 + i, &brand[4 * i + 0], &brand[4 * i + 1], &brand[4 * i + 2], &brand[4 * i + 3]);
+			model = std::string(reinterpret_cast<const char *>(brand), sizeof(brand)).c_str();
+		}
+#else
+		std::ifstream cpuinfo("/proc/cpuinfo");
+		std::string line;
+		while (model.empty() && std::getline(cpuinfo, line))
+		{
+			if ((line.compare(0, 10, "model name") == 0) || (line.compare(0, 8, "CPU part") == 0)) model = line.substr(line.find(':') + 1);
+		}
+#endif
+		const size_t first = model.find_first_not_of(' '), last = model.find_last_not_of(' ');
+		return (first == std::string::npos) ? "unknown" : model.substr(first, last - first + 1);
+	}
+
+	// The tuning file contains the lines 'cpu model;n;implementation;threads'
+	static void readTuning(std::vector<std::string> & lines)
+	{
+		std::ifstream inFile(tuneFilename());
+		std::string line;
+		while (std::getline(inFile, line)) if (!line.empty()) lines.push_back(line);
+	}
+
+public:
+	// Read the best implementation and thread count of each n for this CPU
+	void loadTuning()
+	{
+		const std::string model = cpuModel() + ";";
+		std::vector<std::string> lines; readTuning(lines);
+		for (const std::string & line : lines)
+		{
+			if (line.compare(0, model.size(), model) != 0) continue;
+			std::istringstream ss(line.substr(model.size()));
+			std::string nstr, impl, tstr;
+			if (std::getline(ss, nstr, ';') && std::getline(ss, impl, ';') && std::getline(ss, tstr))
+			{
+				_tuning[static_cast<uint32_t>(std::atoi(nstr.c_str()))] = std::make_pair(impl, size_t(std::atoi(tstr.c_str())));
+			}
+		}
+	}
+
+	// Time every implementation and thread count for each n. The smallest thread count within 3% of the best time is selected.
+	EReturn tune(const uint32_t n_arg)
+	{
+		std::vector<std::string> impls;
+		{
+			std::istringstream iss(transform::implementations());
+			std::string s; while (iss >> s) impls.push_back(s);
+		}
+		const std::vector<size_t> threads = threadCounts();
+		const std::string model = cpuModel();
+
+		const bool emptyMainFilename = _mainFilename.empty();
+		if (emptyMainFilename) _mainFilename = "tune";
+
+		std::ostringstream ss_m; ss_m << "Tuning " << model << "." << std::endl;
+		pio::print(ss_m.str());
+
+		std::map<uint32_t, std::pair<std::string, size_t>> best;
+		for (uint32_t n = 15; (n <= 22) && !_quit; ++n)
+		{
+			if ((n_arg != 0) && (n != n_arg)) continue;
+
+			std::vector<benchResult> results;
+			double t_min = 0;
+			for (const std::string & impl : impls)
+			{
+				for (const size_t nt : threads)
+				{
+					if (_quit) break;
+					const benchResult r = benchConfig(benchBase(n, 1), n, "medium", 0, nt, impl);
+					if (!r.valid || (r.repeats == 0)) continue;
+					results.push_back(r);
+					if ((t_min == 0) || (r.median < t_min)) t_min = r.median;
+				}
+			}
+			if (results.empty()) continue;
+
+			const benchResult * sel = nullptr;
+			for (const benchResult & r : results)
+			{
+				if (r.median > 1.03 * t_min) continue;
+				if ((sel == nullptr) || (r.nthreads < sel->nthreads) || ((r.nthreads == sel->nthreads) && (r.median < sel->median))) sel = &r;
+			}
+			best[n] = std::make_pair(sel->impl, sel->nthreads);
+
+			clearline();
+			std::ostringstream ss; ss << "n = " << n << ": " << sel->impl << " (" << sel->kind << "), " << sel->nthreads << " thread(s), "
+									  << std::setprecision(3) << sel->median << " ms/bit." << std::endl;
+			pio::print(ss.str());
+		}
+
+		if (emptyMainFilename) _mainFilename.clear();
+		if (best.empty()) return _quit ? EReturn::Aborted : EReturn::Failed;
+
+		// the entries of the other CPUs and of the other n are kept
+		std::vector<std::string> lines; readTuning(lines);
+		std::ofstream outFile(tuneFilename());
+		for (const std::string & line : lines)
+		{
+			std::istringstream ss(line);
+			std::string m, nstr;
+			if (std::getline(ss, m, ';') && std::getline(ss, nstr, ';') && (m == model) && (best.count(static_cast<uint32_t>(std::atoi(nstr.c_str()))) != 0)) continue;
+			outFile << line << std::endl;
+		}
+		for (const auto & e : best) outFile << model << ";" << e.first << ";" << e.second.first << ";" << e.second.second << std::endl;
+		if (!outFile) { pio::error("cannot write tuning file"); return EReturn::Failed; }
+
+		return _quit ? EReturn::Aborted : EReturn::Success;
+	}
+
+private:
+#endif
+
+#if !defined(GPU)
+	// Probability that a round-off error reaches 1/2 during a test of b^{2^n} + 1.
+	// The error of a digit is assumed to be Gaussian: sigma is fitted to the median of the maximum error of some squarings of a random number,
+	// P(max < m) = (1 - erfc(m / (sigma sqrt(2))))^N = 1/2.
+	double roundoffFailure(const uint32_t b, const uint32_t n, const size_t nthreads, const std::string & impl)
+	{
+		createTransformCPU(b, n, nthreads, impl, 3, true, false);
+		transform * const pTransform = _transform;
+
+		const size_t N = size_t(1) << n;
+		gint g(N, b);
+		std::mt19937 rng(b);
+		std::uniform_int_distribution<uint32_t> digit(0, b - 1);
+		int32_t * const d = g.data();
+		for (size_t i = 0; i < N; ++i) d[i] = static_cast<int32_t>(digit(rng));
+		g.reset();
+		pTransform->setInt(g);
+
+		for (size_t i = 0; i < 16; ++i) pTransform->squareDup(false);
+
+		static const size_t count = 256;
+		std::vector<double> err(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			pTransform->resetError();
+			pTransform->squareDup(false);
+			err[i] = pTransform->getError();
+		}
+		std::sort(err.begin(), err.end());
+		const double m = err[count / 2];
+		if (m <= 0) return 0;
+		if ((m >= 0.4) || (err[count - 1] >= 0.5)) return 1;
+
+		// erfc(x) = ln(2) / N, x = m / (sigma sqrt(2))
+		const double p_m = std::log(2.0) / N;
+		double x_min = 0, x_max = 10;
+		for (size_t i = 0; i < 64; ++i)
+		{
+			const double x = 0.5 * (x_min + x_max);
+			if (std::erfc(x) > p_m) x_min = x; else x_max = x;
+		}
+		const double x = 0.5 * (x_min + x_max);
+
+		// the test is about N log2(b) squarings of N digits
+		const double iters = N * std::log2(double(b));
+		return std::min(iters * N * std::erfc(0.5 * x / m), 1.0);
+	}
+
+	// Bisection: b is valid if the estimated probability of a round-off failure is less than 1%.
+	EReturn estimate_limit(const uint32_t n, const size_t nthreads, const std::string & impl)
+	{
+		uint32_t b_min = 100000, b_max = 2000000000;
+		while (b_max - b_min > 5000)
+		{
+			const uint32_t b = (b_min + b_max) / 4 * 2;
+			if (roundoffFailure(b, n, nthreads, impl) < 0.01) b_min = b; else b_max = b;
+			if (_quit) break;
+		}
+		deleteTransform();
+
+		const uint32_t b = (b_min + b_max) / 4 * 2;
+		std::ostringstream ss; ss << n << ": " << b << " (" << transform::familyName(_kind) << ", estimated)" << std::endl;
+		pio::print(ss.str());
+
+		return _quit ? EReturn::Aborted : EReturn::Success;
+	}
+#endif
+
 	EReturn check_limit(const uint32_t n, const size_t device, const size_t nthreads, const std::string & impl)
 	{
+#if !defined(GPU)
+		const bool ntt = (impl == "i32") || (_kind == transform::EFamily::NTT);
+		// the limit of each floating-point transform
+		if (!ntt && (_kind == transform::EFamily::Auto))
+		{
+			for (const transform::EFamily family : transform::families())
+			{
+				_kind = family;
+				const EReturn ret = check_limit(n, device, nthreads, impl);
+				_kind = transform::EFamily::Auto;
+				if (ret != EReturn::Success) return ret;
+			}
+			return EReturn::Success;
+		}
+		// the NTT is exact, the limit of the floating-point transforms is estimated from the round-off errors
+		if (!_limitExact && !ntt) return estimate_limit(n, nthreads, impl);
+#endif
 		const size_t num_regs = 3;
 
 		mpz_t exponent; mpz_init(exponent); mpz_ui_pow_ui(exponent, 3, 1000);
@@ -1151,17 +2366,25 @@ private:
 		mpz_clear(exponent);
 
 		const uint32_t b = (b_min + b_max) / 4 * 2;
-		std::ostringstream ss; ss << n << ": " << b << std::endl;
+		std::ostringstream ss; ss << n << ": " << b;
+#if !defined(GPU)
+		ss << " (" << transform::familyName(ntt ? transform::EFamily::NTT : _kind) << ")";
+#endif
+		ss << std::endl;
 		pio::print(ss.str());
 
 		return _quit ? EReturn::Aborted : EReturn::Success;
 	}
 
 public:
-	EReturn check(const uint32_t b, const uint32_t n, const EMode mode, const size_t device, const size_t nthreads, const std::string & impl,
-				  const int depth, const bool oldfashion = false)
+	EReturn check(const uint32_t b, const uint32_t n, const EMode mode, const size_t device, const size_t nthreads_arg, const std::string & impl_arg,
+				  const int depth_arg, const bool oldfashion = false)
 	{
 		_n = n;
+		_errorSampling = false; _escalated = false; _reg_size = 0;
+#if !defined(GPU)
+		_isCtxPlan = false;
+#endif
 		const bool emptyMainFilename = _mainFilename.empty();
 		if (emptyMainFilename)
 		{
@@ -1169,58 +2392,153 @@ public:
 			_mainFilename = ss.str();
 		}
 
-		if (mode == EMode::Bench) return bench(n, device, nthreads, impl);
-		if (mode == EMode::Limit) return check_limit(n, device, nthreads, impl);
+		if (mode == EMode::Bench) return bench(n, device, nthreads_arg, impl_arg);
+		if (mode == EMode::Limit) return check_limit(n, device, nthreads_arg, impl_arg);
+
+		// the tuning file (if loaded) selects the implementation and the number of threads
+		std::string impl = impl_arg; size_t nthreads = nthreads_arg;
+		const auto tuning = _tuning.find(n);
+		if (tuning != _tuning.end()) { impl = tuning->second.first; nthreads = tuning->second.second; }
+
+		// The depth of the proof and the number of checkpoints held in memory are saved for the resumption of the test:
+		// depth = 0 is selected by the cost model and the registers of the context depend on the memory budget.
+		int depth = depth_arg; bool stored = false;
+		_mem_ckpts = 0;
+		if (mode == EMode::Proof)
+		{
+			file depthFile(depthFilename());
+			int rdepth = 0; uint32_t mem_ckpts = 0;
+			if (depthFile.exists() && depthFile.read(reinterpret_cast<char *>(&rdepth), sizeof(rdepth))
+				&& depthFile.read(reinterpret_cast<char *>(&mem_ckpts), sizeof(mem_ckpts)) && depthFile.check_crc32()
+				&& (rdepth > 0) && ((depth == 0) || (rdepth == depth)))
+			{
+				depth = rdepth; _mem_ckpts = size_t(mem_ckpts); stored = true;
+			}
+		}
 
-		bool fast_checkpoints =
+		// the checkpoints of the proof are held in registers: all of them on GPU if n <= 17 and if the memory of the device is large enough,
+		// within the memory budget on CPU.
+		// The budget contains the multiplicands of the proof. The overflow is written to disk.
+		auto memCkpts = [&](const int d) -> size_t
+		{
+			if ((mode != EMode::Proof) || (d == 0)) return 0;
 #if defined(GPU)
-			(n <= 17);
+			const size_t ckpts = size_t(1) << d;
+			return ((n <= 17) && (3 + ckpts <= _transform->getMaxRegs())) ? ckpts : 0;
 #else
-			false;
+			if (_memBudget == 0) return 0;
+			const size_t regs = (_memBudget << 20) / _reg_size, slots = multiExpSlots() + 1;
+			return (regs > slots) ? std::min(size_t(1) << d, regs - slots) : 0;
 #endif
+		};
+
 		size_t num_regs;
 		if (mode == EMode::Quick) num_regs = 3;
-		else if (mode == EMode::Proof) num_regs = fast_checkpoints ? 3 + (size_t(1) << depth) : 3;
+		else if (mode == EMode::Proof) num_regs = 3 + _mem_ckpts;
 		else if (mode == EMode::Server) num_regs = 4;
 		else if (mode == EMode::Check) num_regs = 4;
 		else return EReturn::Failed;
 
+		size_t nthreads1 = nthreads, nthreads2 = 0;
+		bool checkError = false;
 #if defined(GPU)
-		(void)nthreads; (void)impl;
+		(void)nthreads; (void)nthreads1; (void)impl;
 		createTransformGPU(b, n, device, num_regs);
 #else
-		bool checkError =
+		// the transform of a context is selected if the family is not set: the default family may be different in another release
+		if (_kind == transform::EFamily::Auto) _isCtxPlan = readContextPlan(_ctx_plan);
 #if defined(CYCLO)
-			true;
+		checkError = true;
 #else
-			false;
-
-		static constexpr uint32_t bm[23 - 12 + 1] = { 2000, 2000, 2000, 2000, 1500, 1000, 94, 71, 54, 41, 31, 24 };
-		if (impl != "i32")
+		// the round-off error of a test is checked at sampled iterations if b is close to the limit of the transform,
+		// at each iteration of a check if b is larger than the limit
+		const transform::plan plan = getPlan(b, n, impl);
+		const double b_ratio = transform::bRatio(b, n, plan);
+		if (b_ratio > sampling_margin)
 		{
-			if (b > bm[n - 12] * 1000000) checkError = true;
+			if ((mode == EMode::Quick) || (mode == EMode::Proof)) _errorSampling = true; else checkError = (b_ratio > 1);
 		}
 #endif
 		(void)device;
-		createTransformCPU(b, n, nthreads, impl, num_regs, checkError);
+		// check mode: the two chains are computed concurrently, each on half of the threads
+		if ((mode == EMode::Check) && !_isBoinc)
+		{
+			const size_t nt = (nthreads == 0) ? size_t(omp_get_max_threads()) : nthreads;
+			if (nt >= 2) { nthreads1 = std::min((nt + 1) / 2, max_threads); nthreads2 = std::min(nt / 2, max_threads); }
+		}
+		createTransformCPU(b, n, nthreads1, impl, num_regs, checkError);
 
 #if !defined(CYCLO)
-		if (!_isBoinc && checkError)
+		if (!_isBoinc && (b_ratio > 1))
 		{
-			std::ostringstream ss; ss << "Warning: b > " << bm[n - 12] << ",000,000: the test may fail." << std::endl;
+			std::ostringstream ss; ss << "Warning: b is larger than the limit of the transform (" << transform::familyName(plan.family) << "): the test may fail";
+			if (_errorSampling) ss << ", the round-off error is monitored";
+			ss << "." << std::endl;
 			pio::print(ss.str());
 		}
 #endif
 #endif
 		_gi = new gint(size_t(1) << n, b);
 
+		if (mode == EMode::Proof)
+		{
+			if (depth == 0)
+			{
+				double sqrTime = 0, mulTime = 0, testTime = 0, proofTime = 0, serverTime = 0;
+				measureOps(sqrTime, mulTime);
+				const bool straus = _transform->selectMultiplicand(multiExpSlots());
+				_transform->selectMultiplicand(0);
+				depth = proofDepth(b, sqrTime, mulTime, straus, testTime, proofTime, serverTime);
+				if (!_isBoinc)
+				{
+					std::ostringstream ss; ss << "Proof depth = " << depth << ", estimated time: test " << timer::formatTime(testTime)
+						<< ", proof " << timer::formatTime(proofTime) << ", server and check 2 x " << timer::formatTime(serverTime) << "." << std::endl;
+					pio::print(ss.str());
+				}
+			}
+			else if ((depth_arg == 0) && !_isBoinc)
+			{
+				std::ostringstream ss; ss << "Proof depth = " << depth << "." << std::endl;
+				pio::print(ss.str());
+			}
+
+			if (!stored)
+			{
+				_mem_ckpts = memCkpts(depth);
+				file depthFile(depthFilename(), "wb", false);
+				const uint32_t mem_ckpts = static_cast<uint32_t>(_mem_ckpts);
+				depthFile.write(reinterpret_cast<const char *>(&depth), sizeof(depth));
+				depthFile.write(reinterpret_cast<const char *>(&mem_ckpts), sizeof(mem_ckpts));
+				depthFile.write_crc32();
+
+				if (3 + _mem_ckpts != num_regs)
+				{
+					num_regs = 3 + _mem_ckpts;
+#if defined(GPU)
+					createTransformGPU(b, n, device, num_regs, false);
+#else
+					createTransformCPU(b, n, nthreads1, impl, num_regs, checkError, false);
+#endif
+				}
+			}
+		}
+		const bool fast_checkpoints = (_mem_ckpts != 0);
+
+#if !defined(GPU)
+		if (!_isBoinc && (_mem_ckpts != 0))
+		{
+			std::ostringstream ss; ss << _mem_ckpts << " of " << (size_t(1) << depth) << " proof checkpoints are held in memory." << std::endl;
+			pio::print(ss.str());
+		}
+#endif
+
 		EReturn success = EReturn::Failed;
 
 		if (mode == EMode::Check)
 		{
-			double time = 0; uint64_t ckey = 0;
-			success = check(time, ckey);
-			const double error = _transform->getError();
+			double time = 0, error2 = 0; uint64_t ckey = 0;
+			success = check(time, ckey, error2, nthreads2, impl, checkError);
+			const double error = std::max(_transform->getError(), error2);
 			clearline();
 			std::ostringstream ss; ss << gfn(b, n);
 			if (success == EReturn::Success)
@@ -1341,12 +2659,175 @@ public:
 		}
 
 		delete _gi; _gi = nullptr;
-		deleteTransform();
+		if (!_reuseTransform) deleteTransform();
 		if (emptyMainFilename) _mainFilename.clear();
 
 		return success;
 	}
 
+#if !defined(GPU)
+	// Largest b of a batch test: the digits are not split and the round-off error is about 0.1
+	static uint32_t batchLimit(const uint32_t n)
+	{
+		static constexpr uint32_t b_max[16 - 12 + 1] = { 2200000, 1500000, 1300000, 1100000, 900000 };
+		return ((n < 12) || (n > 16)) ? 0 : b_max[n - 12];
+	}
+
+	// Number of tests processed simultaneously by checkBatch, 0 if the batch mode is not supported
+	static size_t batchSize(const uint32_t n, const std::string & impl)
+	{
+		return (batchLimit(n) == 0) ? 0 : transformBatch::lanes(impl);
+	}
+
+	// Quick tests of some b_l^{2^n} + 1, l < batchSize(n, impl), in the lanes of the SIMD vectors.
+	// The Gerbicz-Li check is done at the end of the tests and no context file is created.
+	// The round-off error of the lanes is sampled: done[l] is false if the error of test l is too large or if its check failed,
+	// the test must be done again.
+	EReturn checkBatch(const std::vector<uint32_t> & bv, const uint32_t n, const std::string & impl, std::vector<bool> & done)
+	{
+		_n = n;
+		const size_t lanes = transformBatch::lanes(impl), count = std::min(bv.size(), lanes);
+
+		// unused lanes are a copy of the first test
+		std::vector<uint32_t> b(lanes);
+		for (size_t l = 0; l < lanes; ++l) b[l] = bv[(l < count) ? l : 0];
+
+		std::string ttype;
+		transformBatch * const pTransform = transformBatch::create_cpu(b.data(), n, impl, 3, false, ttype);
+		{
+			std::ostringstream ss; ss << "Using " << ttype << " batch implementation, " << count << " tests"
+				<< ", data size: " << std::setprecision(3) << pTransform->getCacheSize() / (1024 * 1024.0) << " MB." << std::endl;
+			pio::print(ss.str());
+		}
+
+		mpz_t * const exponent = new mpz_t[lanes];
+		size_t esize = 0;
+		for (size_t l = 0; l < lanes; ++l)
+		{
+			mpz_init(exponent[l]);
+			mpz_ui_pow_ui(exponent[l], b[l], static_cast<unsigned long int>(1) << n);
+			esize = std::max(esize, mpz_sizeinbase(exponent[l], 2));
+		}
+		const int B_GL = B_GerbiczLi(esize);
+
+		watch chrono;
+		const int i0 = static_cast<int>(esize - 1);
+		initPrintProgress(i0, i0);
+		int dcount = 100;
+
+		EReturn success = EReturn::Success;
+
+		pTransform->set(1);
+		pTransform->copy(1, 0);	// d(t)
+		for (int i = i0; i >= 0; --i)
+		{
+			if (_quit) { success = EReturn::Aborted; break; }
+
+			if (i % dcount == 0)
+			{
+				chrono.read(); const double displayTime = chrono.getDisplayTime();
+				if (displayTime >= 10) { dcount = printProgress(displayTime, i); chrono.resetDisplayTime(); }
+			}
+
+			// one squaring out of 64 is checked
+			const bool sample = (i % 64 == 0);
+			if (sample) pTransform->setCheckError(true);
+			uint32_t dup = 0;
+			for (size_t l = 0; l < lanes; ++l) if (mpz_tstbit(exponent[l], mp_bitcnt_t(i)) != 0) dup |= uint32_t(1) << l;
+			pTransform->squareDup(dup);
+			if (sample) pTransform->setCheckError(false);
+
+			if ((i % B_GL == 0) && (i / B_GL != 0)) pTransform->mulTo(1, 0, 1);	// d(t)
+		}
+
+		std::vector<bool> isPrp(lanes, false), valid(lanes, false);
+		std::vector<uint64_t> res64(lanes, 0), old64(lanes, 0);
+
+		if (success == EReturn::Success)
+		{
+			std::vector<gint *> gi(lanes);
+			for (size_t l = 0; l < lanes; ++l)
+			{
+				gi[l] = new gint(size_t(1) << n, b[l]);
+				pTransform->getInt(*gi[l], l);
+				uint64_t r64 = 0, o64 = 0;
+				isPrp[l] = gi[l]->isOne(r64, o64);
+				res64[l] = r64; old64[l] = o64;
+			}
+
+			clearline(); pio::display("Validating...\r");
+
+			// d(t + 1) = d(t) * result, d(t)^{2^B}
+			pTransform->mulTo(2, 0, 1);
+			pTransform->copy(0, 1);
+			for (int i = B_GL - 1; i >= 0; --i) pTransform->squareDup(0);
+			pTransform->copy(1, 0);
+
+			mpz_t * const res = new mpz_t[lanes];
+			size_t rsize = 0;
+			mpz_t e, t; mpz_init(e); mpz_init(t);
+			for (size_t l = 0; l < lanes; ++l)
+			{
+				mpz_init_set_ui(res[l], 0);
+				mpz_set(e, exponent[l]);
+				while (mpz_sgn(e) != 0)
+				{
+					mpz_mod_2exp(t, e, static_cast<unsigned long int>(B_GL));
+					mpz_add(res[l], res[l], t);
+					mpz_div_2exp(e, e, static_cast<unsigned long int>(B_GL));
+				}
+				rsize = std::max(rsize, mpz_sizeinbase(res[l], 2));
+			}
+			mpz_clear(e); mpz_clear(t);
+
+			// 2^res
+			pTransform->set(1);
+			for (int i = static_cast<int>(rsize) - 1; i >= 0; --i)
+			{
+				uint32_t dup = 0;
+				for (size_t l = 0; l < lanes; ++l) if (mpz_tstbit(res[l], mp_bitcnt_t(i)) != 0) dup |= uint32_t(1) << l;
+				pTransform->squareDup(dup);
+			}
+			for (size_t l = 0; l < lanes; ++l) mpz_clear(res[l]);
+			delete[] res;
+
+			// d(t)^{2^B} * 2^res ?= d(t + 1)
+			pTransform->mul(1);
+			std::vector<uint64_t> h1(lanes);
+			for (size_t l = 0; l < lanes; ++l) { pTransform->getInt(*gi[l], l); h1[l] = gi[l]->gethash64(); }
+			pTransform->copy(0, 2);
+			for (size_t l = 0; l < lanes; ++l) { pTransform->getInt(*gi[l], l); valid[l] = (gi[l]->gethash64() == h1[l]); }
+
+			for (size_t l = 0; l < lanes; ++l) delete gi[l];
+		}
+
+		const double time = chrono.getElapsedTime();
+		clearline();
+		done.assign(count, false);
+		for (size_t l = 0; l < count; ++l)
+		{
+			const double error = pTransform->getError(l);
+			std::ostringstream ss; ss << gfn(b[l], n);
+			if (success == EReturn::Aborted) ss << ": terminated.";
+			else if (error > 0.4) ss << ": round-off error = " << std::setprecision(4) << error << ", the test is done again.";
+			else if (!valid[l]) ss << ": validation failed, the test is done again.";
+			else
+			{
+				ss << gfnStatus(isPrp[l], 0, 0, res64[l], old64[l], error, time);
+				done[l] = true;
+			}
+			ss << std::endl; pio::print(ss.str());
+			if (done[l]) pio::result(ss.str());
+		}
+
+		for (size_t l = 0; l < lanes; ++l) mpz_clear(exponent[l]);
+		delete[] exponent;
+		delete pTransform;
+
+		return success;
+	}
+#endif
+
 	void displaySupportedImplementations()
 	{
 		const std::string impls = transform::implementations();
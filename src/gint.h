@@ -27,6 +27,53 @@ private:
 private:
 	static constexpr uint64_t rotl64(const uint64_t x, const uint8_t n) { return (x << n) | (x >> (-n & 63)); }
 
+	// Packed format: the most significant bit of the size is set and the digits are stored with ceil(log2(b)) bits
+	static const uint32_t packed_flag = uint32_t(1) << 31;
+	static const size_t packed_buffer_size = 1024;
+
+	static int digitBits(const uint32_t base) { return 32 - __builtin_clz(base - 1); }
+
+	void pack(file & cFile) const
+	{
+		const int bits = digitBits(_base);
+		uint32_t buffer[packed_buffer_size]; size_t j = 0;
+		uint64_t acc = 0; int nacc = 0;
+		for (size_t i = 0; i < _size; ++i)
+		{
+			acc |= uint64_t(uint32_t(_d[i])) << nacc; nacc += bits;
+			if (nacc >= 32)
+			{
+				buffer[j++] = uint32_t(acc); acc >>= 32; nacc -= 32;
+				if (j == packed_buffer_size) { if (!cFile.write(reinterpret_cast<const char *>(buffer), sizeof(buffer))) return; j = 0; }
+			}
+		}
+		if (nacc > 0) buffer[j++] = uint32_t(acc);
+		if (j > 0) cFile.write(reinterpret_cast<const char *>(buffer), j * sizeof(uint32_t));
+	}
+
+	void unpack(file & cFile)
+	{
+		const int bits = digitBits(_base);
+		const uint64_t mask = (uint64_t(1) << bits) - 1;
+		const size_t num_words = (_size * size_t(bits) + 31) / 32;
+		uint32_t buffer[packed_buffer_size]; size_t j = 0, len = 0, w = 0;
+		uint64_t acc = 0; int nacc = 0;
+		for (size_t i = 0; i < _size; ++i)
+		{
+			while (nacc < bits)
+			{
+				if (j == len)
+				{
+					len = std::min(packed_buffer_size, num_words - w);
+					if (!cFile.read(reinterpret_cast<char *>(buffer), len * sizeof(uint32_t))) return;
+					w += len; j = 0;
+				}
+				acc |= uint64_t(buffer[j++]) << nacc; nacc += 32;
+			}
+			_d[i] = static_cast<int32_t>(acc & mask); acc >>= bits; nacc -= bits;
+		}
+	}
+
 public:
 	gint(const size_t size, const uint32_t base) : _size(size), _base(base), _d(new int32_t[size]), _state(EState::Unknown) {}
 	virtual ~gint() { delete[] _d; }
@@ -37,6 +84,9 @@ public:
 
 	void reset() { _state = EState::Unknown; }
 
+	// the size and the base are unchanged
+	void copy(const gint & rhs) { std::copy(rhs._d, rhs._d + _size, _d); _state = rhs._state; }
+
 	void unbalance()
 	{
 		if (_state == EState::Unbalanced) return;
@@ -152,18 +202,24 @@ public:
 	{
 		uint32_t size; cFile.read(reinterpret_cast<char *>(&size), sizeof(size));
 		uint32_t base; cFile.read(reinterpret_cast<char *>(&base), sizeof(base));
+		const bool packed = ((size & packed_flag) != 0);
+		size &= ~packed_flag;
 		if ((size_t(size) != _size) || (base != _base)) cFile.error("bad file");
-		cFile.read(reinterpret_cast<char *>(_d), _size * sizeof(int32_t));
+		if (packed) unpack(cFile);
+		else cFile.read(reinterpret_cast<char *>(_d), _size * sizeof(int32_t));
 		_state = EState::Unbalanced;
 	}
 
 	void write(file & cFile)
 	{
 		unbalance();
-		const uint32_t size = static_cast<uint32_t>(_size);
+		const int32_t base = static_cast<int32_t>(_base);
+		const bool packed = std::all_of(_d, _d + _size, [=](const int32_t d) { return (d >= 0) && (d < base); });	// -1 cannot be packed
+		const uint32_t size = static_cast<uint32_t>(_size) | (packed ? packed_flag : 0);
 		cFile.write(reinterpret_cast<const char *>(&size), sizeof(size));
 		cFile.write(reinterpret_cast<const char *>(&_base), sizeof(_base));
-		cFile.write(reinterpret_cast<const char *>(_d), _size * sizeof(int32_t));
+		if (packed) pack(cFile);
+		else cFile.write(reinterpret_cast<const char *>(_d), _size * sizeof(int32_t));
 	}
 
 	bool isOne(uint64_t & res64, uint64_t & old64)
@@ -6,7 +6,9 @@ Please give feedback to the authors if improvement is realized. It is distribute
 */
 
 #include <cstdint>
+#include <cstdio>
 #include <sstream>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <vector>
@@ -159,15 +161,30 @@ private:
 		ss << "  -s                          convert the proof into a certificate and a 64-bit key (server job)" << std::endl;
 		ss << "  -c                          check the certificate: a 64-bit key is generated (must be identical to server key)" << std::endl;
 		ss << "  -h                          validate and bench your hardware" << std::endl;
+		ss << "  --bench <filename>          benchmark suite (implementations, threads, n, b), results in a JSON or .csv file" << std::endl;
+		ss << "                              -n, -t and -x restrict the suite, --pool compares the pool with OpenMP" << std::endl;
+		ss << "  --limit                     estimate the largest b of each n and transform from the round-off errors" << std::endl;
+		ss << "  --limit-exact               find the largest b of each n with a test at each step (slow)" << std::endl;
+		ss << "                              -n restricts the search to a single n" << std::endl;
+		ss << "  -w <filename>               process the worklist file, lines are 'b n mode', mode is q, p, s or c" << std::endl;
 #if defined(GPU)
 		ss << "  -d <n> or --device <n>      set the device number (default 0)" << std::endl;
 #else
 		ss << "  -t <n> or --nthreads <n>    set the number of threads (default: one thread, 0: all logical cores)" << std::endl;
+		ss << "  --tune                      time the implementations and thread counts, the best ones are saved in genefer.tune" << std::endl;
+		ss << "                              and are used if neither -x nor -t is set" << std::endl;
+		ss << "  --pool <spin|park>          use a persistent thread pool, idle threads spin or sleep (default: OpenMP)" << std::endl;
+		ss << "  --mem-budget <MB>           memory of the proof checkpoints and multiplicands (default 0: checkpoints on disk)" << std::endl;
+		ss << "  --kind <dt|ibdt|sbdt|i32>   set the transform (default: the fastest one whose limit is larger than b)" << std::endl;
 #if !defined(__aarch64__)
 		ss << "  -x <implementation>         set a specific implementation (sse2, sse4, avx, fma, 512)" << std::endl;
 #endif
 #endif
 		ss << "  -f <filename>               main filename (without extension) of input and output files" << std::endl;
+		ss << "  --depth <d>                 depth of the proof (1 <= d <= 12, default: selected by a cost model)" << std::endl;
+		ss << "  --disk-budget <MB>          disk space of the proof checkpoints, limits the selected depth (default 4096)" << std::endl;
+		ss << "  --glperiod <t>              period of the Gerbicz-Li error checking in seconds (default 600)" << std::endl;
+		ss << "  --portable                  save portable checkpoints, they can be resumed with any implementation" << std::endl;
 		ss << "  -v or -V                    print the startup banner and exit" << std::endl;
 #if defined(BOINC)
 		ss << "  -boinc                      operate as a BOINC client app" << std::endl;
@@ -176,6 +193,140 @@ private:
 		return ss.str();
 	}
 
+private:
+	static bool parseWork(const std::string & line, uint32_t & b, uint32_t & n, genefer::EMode & mode)
+	{
+		std::istringstream ss(line);
+		std::string mstr;
+		if (!(ss >> b >> n >> mstr)) return false;
+		if (mstr[0] == '-') mstr = mstr.substr(1);
+		if (mstr == "q") mode = genefer::EMode::Quick;
+		else if (mstr == "p") mode = genefer::EMode::Proof;
+		else if (mstr == "s") mode = genefer::EMode::Server;
+		else if (mstr == "c") mode = genefer::EMode::Check;
+		else return false;
+#if !defined(CYCLO)
+		if (b % 2 != 0) return false;
+#endif
+		if ((b > 2000000000) || (b == 0) || ((b & (~b + 1)) == b)) return false;
+		if ((n < 12) || (n > 23)) return false;
+		return true;
+	}
+
+	static bool readWorklist(const std::string & filename, std::vector<std::string> & lines)
+	{
+		lines.clear();
+		std::ifstream wFile(filename);
+		if (!wFile.is_open()) return false;
+		std::string line;
+		while (std::getline(wFile, line))
+		{
+			if (!line.empty() && (line.back() == '\r')) line.pop_back();
+			lines.push_back(line);
+		}
+		return true;
+	}
+
+	// The worklist can be edited during the tests: the file is read again before the line is removed
+	static void removeWork(const std::string & filename, const std::string & work)
+	{
+		std::vector<std::string> lines;
+		if (!readWorklist(filename, lines)) return;
+
+		const std::string newFilename = filename + ".new";
+		{
+			std::ofstream wFile(newFilename);
+			if (!wFile.is_open()) throw std::runtime_error("cannot write worklist file");
+			bool found = false;
+			for (const std::string & line : lines)
+			{
+				if (!found && (line == work)) { found = true; continue; }
+				wFile << line << std::endl;
+			}
+		}
+		std::remove(filename.c_str());
+		if (std::rename(newFilename.c_str(), filename.c_str()) != 0) throw std::runtime_error("cannot write worklist file");
+	}
+
+	static genefer::EReturn worklist(genefer & g, const std::string & filename, const size_t device, const size_t nthreads, const std::string & impl, const int depth)
+	{
+		g.setReuseTransform(true);
+
+		while (true)
+		{
+			std::vector<std::string> lines;
+			if (!readWorklist(filename, lines)) throw std::runtime_error("cannot read worklist file");
+
+			std::string work; uint32_t b = 0, n = 0; genefer::EMode mode = genefer::EMode::None;
+			size_t index = 0;
+			for (; index < lines.size(); ++index)
+			{
+				const std::string & line = lines[index];
+				if (line.find_first_not_of(" \t") == std::string::npos) continue;
+				if (parseWork(line, b, n, mode)) { work = line; break; }
+				std::ostringstream ss; ss << "invalid line '" << line << "' in worklist is removed";
+				pio::error(ss.str());
+				removeWork(filename, line);
+			}
+			if (work.empty()) return genefer::EReturn::Success;
+
+#if !defined(GPU)
+			// quick tests of the same size are processed simultaneously if the transform is single-threaded and if all the lanes are used:
+			// the batch is at most 1.4 times faster than the tests of its lanes (n = 12, 13) and it is slower if some lanes are unused.
+			// The lanes are busy until the largest exponent is processed: the batch is the tests of the worklist whose bases are the closest to b.
+			const size_t batchSize = (nthreads == 1) ? genefer::batchSize(n, impl) : 0;
+			if ((mode == genefer::EMode::Quick) && (batchSize >= 2) && (b <= genefer::batchLimit(n)))
+			{
+				std::vector<std::pair<uint32_t, std::string>> candidates;
+				for (size_t j = index; j < lines.size(); ++j)
+				{
+					const std::string & line = lines[j];
+					if (line.find_first_not_of(" \t") == std::string::npos) continue;
+					uint32_t bj = 0, nj = 0; genefer::EMode modej = genefer::EMode::None;
+					if (!parseWork(line, bj, nj, modej) || (modej != genefer::EMode::Quick) || (nj != n) || (bj > genefer::batchLimit(n))) continue;
+					candidates.push_back(std::make_pair(bj, line));
+				}
+				std::stable_sort(candidates.begin(), candidates.end(),
+					[](const std::pair<uint32_t, std::string> & lhs, const std::pair<uint32_t, std::string> & rhs) { return lhs.first < rhs.first; });
+
+				// the window of count bases that contains the first work and whose range is the smallest
+				const size_t count = std::min(candidates.size(), batchSize);
+				size_t p = 0; while (candidates[p].second != work) ++p;
+				size_t first = (p + 1 >= count) ? p + 1 - count : 0;
+				for (size_t k = first + 1; (k <= p) && (k + count <= candidates.size()); ++k)
+				{
+					if (candidates[k + count - 1].first - candidates[k].first < candidates[first + count - 1].first - candidates[first].first) first = k;
+				}
+
+				std::vector<std::string> works; std::vector<uint32_t> bv;
+				for (size_t k = first; k < first + count; ++k) { works.push_back(candidates[k].second); bv.push_back(candidates[k].first); }
+
+				if (works.size() == batchSize)
+				{
+					std::vector<bool> done;
+					const genefer::EReturn ret = g.checkBatch(bv, n, impl, done);
+					if (ret == genefer::EReturn::Aborted) return ret;
+					// a failed lane is tested alone, with its Gerbicz-Li rollback and round-off monitoring
+					for (size_t k = 0; k < works.size(); ++k)
+					{
+						if (!done[k])
+						{
+							const genefer::EReturn retk = g.check(bv[k], n, mode, device, nthreads, impl, depth);
+							if (retk == genefer::EReturn::Aborted) return retk;
+						}
+						removeWork(filename, works[k]);
+					}
+					continue;
+				}
+			}
+#endif
+
+			const genefer::EReturn ret = g.check(b, n, mode, device, nthreads, impl, depth);
+			if (ret == genefer::EReturn::Aborted) return ret;
+			removeWork(filename, work);
+		}
+	}
+
 public:
 	void run(int argc, char * argv[])
 	{
@@ -228,8 +379,19 @@ public:
 #if defined(BOINC) && defined(GPU)
 		bool ext_device = false;
 #endif
-		std::string mainFilename = "", impl = "";
-		const int depth = 7;
+		std::string mainFilename = "", impl = "", worklistFilename = "", benchFilename = "";
+		bool nthreadsSet = false;
+		int depth = 0;
+		size_t diskBudget = 4096;
+		double glPeriod = 600;
+		bool portable = false;
+		bool limitExact = false;
+#if !defined(GPU)
+		genefer::EPool pool = genefer::EPool::OpenMP;
+		transform::EFamily kind = transform::EFamily::Auto;
+		size_t memBudget = 0;
+		bool tune = false;
+#endif
 
 		// parse args
 		for (size_t i = 0, size = args.size(); i < size; ++i)
@@ -297,6 +459,16 @@ public:
 				if (mode != genefer::EMode::None) throw std::runtime_error("-h used with an incompatible option (-q, -p, -s, -c)");
 				mode = genefer::EMode::Bench;
 			}
+			if ((arg == "--limit") || (arg == "--limit-exact"))
+			{
+				if (mode != genefer::EMode::None) throw std::runtime_error("--limit used with an incompatible option (-q, -p, -s, -c, -h)");
+				mode = genefer::EMode::Limit;
+				limitExact = (arg == "--limit-exact");
+			}
+			if (arg.substr(0, 2) == "-w")
+			{
+				worklistFilename = ((arg == "-w") && (i + 1 < size)) ? args[++i] : arg.substr(2);
+			}
 			if (arg.substr(0, 2) == "-f")
 			{
 				mainFilename = ((arg == "-f") && (i + 1 < size)) ? args[++i] : arg.substr(2);
@@ -317,12 +489,37 @@ public:
 				ext_device = true;
 #endif
 			}
+			if (arg.substr(0, 10) == "--glperiod")
+			{
+				const std::string gstr = ((arg == "--glperiod") && (i + 1 < size)) ? args[++i] : arg.substr(10);
+				glPeriod = std::atof(gstr.c_str());
+				if (glPeriod <= 0) throw std::runtime_error("Gerbicz-Li period must be positive");
+			}
+			if (arg == "--portable") portable = true;
+			if (arg.substr(0, 7) == "--bench")
+			{
+				benchFilename = ((arg == "--bench") && (i + 1 < size)) ? args[++i] : arg.substr(7);
+			}
+			if (arg.substr(0, 7) == "--depth")
+			{
+				const std::string dstr = ((arg == "--depth") && (i + 1 < size)) ? args[++i] : arg.substr(7);
+				depth = std::atoi(dstr.c_str());
+				if ((depth < 1) || (depth > 12)) throw std::runtime_error("proof depth must be in [1, 12]");
+			}
+			if (arg.substr(0, 13) == "--disk-budget")
+			{
+				const std::string mstr = ((arg == "--disk-budget") && (i + 1 < size)) ? args[++i] : arg.substr(13);
+				const int mb = std::atoi(mstr.c_str());
+				if (mb <= 0) throw std::runtime_error("disk budget must be positive");
+				diskBudget = size_t(mb);
+			}
 			if (arg.substr(0, 2) == "-t")
 			{
 				const std::string ntstr = ((arg == "-t") && (i + 1 < size)) ? args[++i] : arg.substr(2);
 				const int nt = std::atoi(ntstr.c_str());
 				if (nt > 64) pio::error("number of threads > 64");
 				nthreads = size_t(std::min(nt, 64));
+				nthreadsSet = true;
 			}
 			if (arg.substr(0, 10) == "--nthreads")
 			{
@@ -330,7 +527,34 @@ public:
 				const int nt = std::atoi(ntstr.c_str());
 				if (nt > 64) pio::error("number of threads > 64");
 				nthreads = size_t(std::min(nt, 64));
+				nthreadsSet = true;
+			}
+#if !defined(GPU)
+			if (arg.substr(0, 6) == "--pool")
+			{
+				const std::string pstr = ((arg == "--pool") && (i + 1 < size)) ? args[++i] : arg.substr(6);
+				if (pstr == "spin") pool = genefer::EPool::Spin;
+				else if (pstr == "park") pool = genefer::EPool::Park;
+				else pio::error("thread pool mode is not valid");
 			}
+			if (arg.substr(0, 12) == "--mem-budget")
+			{
+				const std::string mstr = ((arg == "--mem-budget") && (i + 1 < size)) ? args[++i] : arg.substr(12);
+				const int mb = std::atoi(mstr.c_str());
+				if (mb < 0) throw std::runtime_error("memory budget must be non-negative");
+				memBudget = size_t(mb);
+			}
+			if (arg == "--tune") tune = true;
+			if (arg.substr(0, 6) == "--kind")
+			{
+				const std::string kstr = ((arg == "--kind") && (i + 1 < size)) ? args[++i] : arg.substr(6);
+				if (kstr == "dt") kind = transform::EFamily::DT;
+				else if (kstr == "ibdt") kind = transform::EFamily::IBDT;
+				else if (kstr == "sbdt") kind = transform::EFamily::SBDT;
+				else if (kstr == "i32") kind = transform::EFamily::NTT;
+				else pio::error("transform kind is not valid");
+			}
+#endif
 #if !defined(__aarch64__)
 			if (arg.substr(0, 2) == "-x")
 			{
@@ -362,12 +586,35 @@ public:
 		g.setBoincParam(boinc_platform_id, boinc_device_id);
 #endif
 		g.setFilename(mainFilename);
+		g.setGLPeriod(glPeriod);
+		g.setDiskBudget(diskBudget);
+		g.setPortableContext(portable);
+		g.setLimitExact(limitExact);
+#if !defined(GPU)
+		g.setPool(pool);
+		g.setKind(kind);
+		g.setMemBudget(memBudget);
+
+		if (tune)
+		{
+			g.tune(n);
+			return;
+		}
+		if (!nthreadsSet && impl.empty()) g.loadTuning();
+#endif
+
+		if (!benchFilename.empty())
+		{
+			g.benchSuite(benchFilename, n, device, nthreadsSet ? nthreads : 0, impl);
+			return;
+		}
 
 		if ((mode == genefer::EMode::Bench) || (mode == genefer::EMode::Limit))
 		{
-			for (size_t n = 15; n <= 22; ++n)
+			const bool single = (mode == genefer::EMode::Limit) && (n != 0);
+			for (uint32_t k = single ? n : 15; k <= (single ? n : 22); ++k)
 			{
-				if (g.check(0, n, mode, device, nthreads, impl, depth) != genefer::EReturn::Success) return;
+				if (g.check(0, k, mode, device, nthreads, impl, depth) != genefer::EReturn::Success) return;
 			}
 			if (mode == genefer::EMode::Bench)
 			{
@@ -377,6 +624,18 @@ public:
 			return;
 		}
 
+		if (!worklistFilename.empty())
+		{
+			if (mode != genefer::EMode::None) throw std::runtime_error("-w used with an incompatible option (-q, -p, -s, -c, -h)");
+			const genefer::EReturn ret = worklist(g, worklistFilename, device, nthreads, impl, depth);
+			if (ret == genefer::EReturn::Aborted)
+			{
+				std::ostringstream ss; ss << std::endl;
+				pio::print(ss.str());
+			}
+			return;
+		}
+
 		if ((mode == genefer::EMode::None) || (b == 0) || (n == 0))
 		{
 			// internal test
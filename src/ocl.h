@@ -21,9 +21,11 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include <map>
 #include <algorithm>
 #include <cstring>
+#include <cstdio>
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <iterator>
 #include <algorithm>
 
 #include "pio.h"
@@ -289,8 +291,10 @@ private:
 #endif
 	size_t _syncCount = 0;
 	cl_ulong _localMemSize = 0;
+	cl_ulong _globalMemSize = 0, _maxMemAllocSize = 0;
 	size_t _maxWorkGroupSize = 0;
 	cl_ulong _timerResolution = 0;
+	std::string _name, _driverVersion;
 	cl_context _context = nullptr;
 	cl_command_queue _queueF = nullptr;
 	cl_command_queue _queueP = nullptr;
@@ -328,20 +332,22 @@ public:
 
 		cl_uint computeUnits; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(computeUnits), &computeUnits, nullptr));
 		cl_uint maxClockFrequency; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(maxClockFrequency), &maxClockFrequency, nullptr));
-		cl_ulong memSize; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(memSize), &memSize, nullptr));
+		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(_globalMemSize), &_globalMemSize, nullptr));
+		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, sizeof(_maxMemAllocSize), &_maxMemAllocSize, nullptr));
 		cl_ulong memCacheSize; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_GLOBAL_MEM_CACHE_SIZE, sizeof(memCacheSize), &memCacheSize, nullptr));
 		cl_uint memCacheLineSize; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE, sizeof(memCacheLineSize), &memCacheLineSize, nullptr));
 		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(_localMemSize), &_localMemSize, nullptr));
 		cl_ulong memConstSize; oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(memConstSize), &memConstSize, nullptr));
 		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(_maxWorkGroupSize), &_maxWorkGroupSize, nullptr));
 		oclFatal(clGetDeviceInfo(_device, CL_DEVICE_PROFILING_TIMER_RESOLUTION, sizeof(_timerResolution), &_timerResolution, nullptr));
+		_name = deviceName; _driverVersion = driverVersion;
 
 		if (verbose)
 		{
 			std::ostringstream ssd;
 			ssd << "Running on device '" << deviceName << "', vendor '" << deviceVendor
 				<< "', version '" << deviceVersion << "', driver '" << driverVersion << "'";
-			// ssd << computeUnits << " compUnits @ " << maxClockFrequency << "MHz, mem=" << (memSize >> 20) << "MB, cache="
+			// ssd << computeUnits << " compUnits @ " << maxClockFrequency << "MHz, mem=" << (_globalMemSize >> 20) << "MB, cache="
 			// 	<< (memCacheSize >> 10) << "kB, cacheLine=" << memCacheLineSize << "B, localMem=" << (_localMemSize >> 10)
 			// 	<< "kB, constMem=" << (memConstSize >> 10) << "kB, maxWorkGroup=" << _maxWorkGroupSize << "." << std::endl;
 			pio::print(ssd.str());
@@ -375,7 +381,11 @@ public:
 public:
 	size_t getMaxWorkGroupSize() const { return _maxWorkGroupSize; }
 	size_t getLocalMemSize() const { return _localMemSize; }
+	size_t getGlobalMemSize() const { return _globalMemSize; }
+	size_t getMaxMemAllocSize() const { return _maxMemAllocSize; }
 	size_t getTimerResolution() const { return _timerResolution; }
+	const std::string & getName() const { return _name; }
+	const std::string & getDriverVersion() const { return _driverVersion; }
 
 private:
 	static EVendor getVendor(const std::string & vendorString)
@@ -441,6 +451,91 @@ public:
 		resetProfiles();
 	}
 
+private:
+	// The name of the cached binary is a hash (FNV-1a) of the source, the build options, the device and the driver
+	std::string binaryFilename(const std::string & programSrc, const char * const pgmOptions) const
+	{
+		uint64_t h = 0xcbf29ce484222325ull;
+		for (const std::string & str : { programSrc, std::string(pgmOptions), _name, _driverVersion })
+		{
+			for (const char c : str) { h ^= static_cast<uint8_t>(c); h *= 0x100000001b3ull; }
+			h ^= 0xff; h *= 0x100000001b3ull;	// separator
+		}
+		std::ostringstream ss; ss << "genefer_" << std::hex << std::setfill('0') << std::setw(16) << h << ".bin";
+		return pio::cachePath(ss.str());
+	}
+
+	// The cached binaries are listed in an index file, most recently used last. The least recently used ones are removed.
+	static void useBinary(const std::string & filename)
+	{
+		static const size_t max_binaries = 8;
+		const std::string indexFilename = pio::cachePath("genefer_bin.idx");
+		std::vector<std::string> binaries;
+		{
+			std::ifstream indexFile(indexFilename);
+			std::string line;
+			while (std::getline(indexFile, line)) if (!line.empty() && (line != filename)) binaries.push_back(line);
+		}
+		binaries.push_back(filename);
+		while (binaries.size() > max_binaries)
+		{
+			std::remove(binaries.front().c_str());
+			binaries.erase(binaries.begin());
+		}
+
+		const std::string tmpFilename = indexFilename + ".tmp";
+		{
+			std::ofstream indexFile(tmpFilename);
+			for (const std::string & binary : binaries) indexFile << binary << std::endl;
+			if (!indexFile) return;
+		}
+		std::remove(indexFilename.c_str());
+		std::rename(tmpFilename.c_str(), indexFilename.c_str());
+	}
+
+	// false if the file doesn't exist or if the binary is rejected by the driver
+	bool loadBinary(const std::string & filename, const char * const pgmOptions)
+	{
+		std::ifstream binFile(filename, std::ios::binary);
+		if (!binFile.is_open()) return false;
+		const std::vector<char> binary((std::istreambuf_iterator<char>(binFile)), std::istreambuf_iterator<char>());
+		if (binary.empty()) return false;
+
+		const size_t binSize = binary.size();
+		const unsigned char * bin = reinterpret_cast<const unsigned char *>(binary.data());
+		cl_int status = CL_SUCCESS, err_cpwb = CL_SUCCESS;
+		cl_program program = clCreateProgramWithBinary(_context, 1, &_device, &binSize, &bin, &status, &err_cpwb);
+		if ((err_cpwb != CL_SUCCESS) || (status != CL_SUCCESS))
+		{
+			if (program != nullptr) clReleaseProgram(program);
+			return false;
+		}
+		if (clBuildProgram(program, 1, &_device, pgmOptions, nullptr, nullptr) != CL_SUCCESS)
+		{
+			clReleaseProgram(program);
+			return false;
+		}
+		_program = program;
+		return true;
+	}
+
+	void saveBinary(const std::string & filename) const
+	{
+		size_t binSize = 0;
+		if ((clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, nullptr) != CL_SUCCESS) || (binSize == 0)) return;
+		std::vector<unsigned char> binary(binSize);
+		unsigned char * bin = binary.data();
+		if (clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(unsigned char *), &bin, nullptr) != CL_SUCCESS) return;
+
+		// written and renamed: another process may read the cache
+		const std::string tmpFilename = filename + ".tmp";
+		{
+			std::ofstream binFile(tmpFilename, std::ios::binary);
+			if (!binFile.write(reinterpret_cast<const char *>(bin), std::streamsize(binSize))) return;
+		}
+		std::rename(tmpFilename.c_str(), filename.c_str());
+	}
+
 public:
 	void loadProgram(const std::string & programSrc)
 	{
@@ -448,16 +543,20 @@ public:
 		std::ostringstream ss; ss << "Load ocl program." << std::endl;
 		pio::display(ss.str());
 #endif
-		const char * src[1]; src[0] = programSrc.c_str();
-		cl_int err_cpws;
-		_program = clCreateProgramWithSource(_context, 1, src, nullptr, &err_cpws);
-		oclFatal(err_cpws);
-
 		char pgmOptions[1024];
 		strcpy(pgmOptions, "");
 #if defined(ocl_debug)
 		strcat(pgmOptions, " -cl-nv-verbose");
 #endif
+
+		const std::string binFilename = binaryFilename(programSrc, pgmOptions);
+		if (loadBinary(binFilename, pgmOptions)) { useBinary(binFilename); return; }
+
+		const char * src[1]; src[0] = programSrc.c_str();
+		cl_int err_cpws;
+		_program = clCreateProgramWithSource(_context, 1, src, nullptr, &err_cpws);
+		oclFatal(err_cpws);
+
 		const cl_int err = clBuildProgram(_program, 1, &_device, pgmOptions, nullptr, nullptr);
 
 #if !defined(ocl_debug)
@@ -482,14 +581,8 @@ public:
 
 		oclFatal(err);
 
-#if defined(ocl_debug)
-		size_t binSize; clGetProgramInfo(_program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binSize, nullptr);
-		std::vector<char> binary(binSize);
-		clGetProgramInfo(_program, CL_PROGRAM_BINARIES, sizeof(char *), &binary, nullptr);
-		std::ofstream fileOut("pgm.bin", std::ios::binary);
-		fileOut.write(binary.data(), std::streamsize(binSize));
-		fileOut.close();
-#endif	
+		saveBinary(binFilename);
+		useBinary(binFilename);
 	}
 
 public:
@@ -526,6 +619,17 @@ public:
 		return mem;
 	}
 
+public:
+	// The region of a buffer: origin must be a multiple of CL_DEVICE_MEM_BASE_ADDR_ALIGN
+	static cl_mem _createSubBuffer(cl_mem & mem, const cl_mem_flags flags, const size_t origin, const size_t size)
+	{
+		cl_buffer_region region; region.origin = origin; region.size = size;
+		cl_int err;
+		cl_mem sub = clCreateSubBuffer(mem, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+		oclFatal(err);
+		return sub;
+	}
+
 public:
 	static void _releaseBuffer(cl_mem & mem)
 	{
@@ -537,17 +641,17 @@ public:
 	}
 
 protected:
-	void _readBuffer(cl_mem & mem, void * const ptr, const size_t size)
+	void _readBuffer(cl_mem & mem, void * const ptr, const size_t size, const size_t offset = 0)
 	{
 		_sync();
-		oclFatal(clEnqueueReadBuffer(_queue, mem, CL_TRUE, 0, size, ptr, 0, nullptr, nullptr));
+		oclFatal(clEnqueueReadBuffer(_queue, mem, CL_TRUE, offset, size, ptr, 0, nullptr, nullptr));
 	}
 
 protected:
-	void _writeBuffer(cl_mem & mem, const void * const ptr, const size_t size)
+	void _writeBuffer(cl_mem & mem, const void * const ptr, const size_t size, const size_t offset = 0)
 	{
 		_sync();
-		oclFatal(clEnqueueWriteBuffer(_queue, mem, CL_TRUE, 0, size, ptr, 0, nullptr, nullptr));
+		oclFatal(clEnqueueWriteBuffer(_queue, mem, CL_TRUE, offset, size, ptr, 0, nullptr, nullptr));
 	}
 
 protected:
@@ -98,6 +98,20 @@ private:
 		return true;
 	}
 
+private:
+	// boinc: the slot directory is cleared after each task, the cache files are in the project directory
+	std::string _cachePath(const std::string & filename) const
+	{
+#if defined(BOINC)
+		if (_isBoinc)
+		{
+			APP_INIT_DATA init_data; boinc_get_init_data(init_data);
+			if (init_data.project_dir[0] != '\0') return std::string(init_data.project_dir) + "/" + filename;
+		}
+#endif
+		return filename;
+	}
+
 private:
 	FILE * _open(const char * const filename, const char * const mode) const
 	{
@@ -117,4 +131,5 @@ public:
 	static bool result(const std::string & str, const std::string & filename = "") { return getInstance()._result(str, filename); }
 
 	static FILE * open(const char * const filename, const char * const mode) { return getInstance()._open(filename, mode); }
+	static std::string cachePath(const std::string & filename) { return getInstance()._cachePath(filename); }
 };
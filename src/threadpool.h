@@ -0,0 +1,131 @@
+/*
+Copyright 2022, Yves Gallot
+
+genefer is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// A persistent team of threads. Thread #0 is the caller of run, the num_threads - 1 workers live as long as the pool.
+// The barriers are sense-reversing spin barriers. Idle workers spin, then yield (Spin) or sleep (Park).
+class threadPool
+{
+public:
+	enum class EWait { Spin, Park };
+
+private:
+	static const size_t spin_count = 1 << 10;
+
+	struct alignas(64) sense { bool local = false; };
+
+	const size_t _num_threads;
+	const EWait _wait;
+	std::vector<std::thread> _workers;
+	std::vector<sense> _sense;
+	alignas(64) std::atomic<size_t> _count;
+	alignas(64) std::atomic<bool> _global_sense;
+	alignas(64) std::atomic<uint64_t> _job;
+	std::atomic<size_t> _sleeping;
+	std::atomic<bool> _quit;
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	void (* _task)(const void * const, const size_t) = nullptr;
+	const void * _arg = nullptr;
+
+private:
+	static void pause()
+	{
+#if defined(__x86_64) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		__asm__ __volatile__("yield");
+#endif
+	}
+
+	void worker(const size_t thread_id)
+	{
+		uint64_t job = 0;
+		while (true)
+		{
+			for (size_t i = 0; _job.load(std::memory_order_acquire) == job; ++i)
+			{
+				if (i < spin_count) pause();
+				else if (_wait == EWait::Spin) std::this_thread::yield();
+				else
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_sleeping.fetch_add(1);
+					_cv.wait(lock, [&] { return _job.load() != job; });
+					_sleeping.fetch_sub(1);
+				}
+			}
+			++job;	// the next job is not started before all threads reach the final barrier
+
+			if (_quit.load(std::memory_order_acquire)) return;
+			_task(_arg, thread_id);
+			barrier(thread_id);
+		}
+	}
+
+public:
+	threadPool(const size_t num_threads, const EWait wait) : _num_threads(num_threads), _wait(wait), _sense(num_threads),
+		_count(num_threads), _global_sense(false), _job(0), _sleeping(0), _quit(false)
+	{
+		for (size_t i = 1; i < num_threads; ++i) _workers.push_back(std::thread(&threadPool::worker, this, i));
+	}
+
+	virtual ~threadPool()
+	{
+		_quit.store(true, std::memory_order_release);
+		_job.fetch_add(1);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_cv.notify_all();
+		}
+		for (std::thread & t : _workers) t.join();
+	}
+
+	size_t getNumThreads() const { return _num_threads; }
+
+	void barrier(const size_t thread_id)
+	{
+		bool & local = _sense[thread_id].local;
+		local = !local;
+		if (_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			_count.store(_num_threads, std::memory_order_relaxed);
+			_global_sense.store(local, std::memory_order_release);
+		}
+		else
+		{
+			for (size_t i = 0; _global_sense.load(std::memory_order_acquire) != local; ++i)
+			{
+				if (i < spin_count) pause(); else std::this_thread::yield();
+			}
+		}
+	}
+
+	// f(thread_id) is called by all threads of the team, run returns when all calls are completed
+	template<typename F>
+	void run(const F & f)
+	{
+		_arg = &f;
+		_task = [](const void * const arg, const size_t thread_id) { (*static_cast<const F *>(arg))(thread_id); };
+		_job.fetch_add(1);
+		if (_sleeping.load() != 0)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_cv.notify_all();
+		}
+		f(0);
+		barrier(0);
+	}
+};
@@ -10,20 +10,30 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include <cstdint>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "gint.h"
 #include "file.h"
+#if !defined(GPU)
+#include "threadpool.h"
+#endif
 
 class transform
 {
 protected:
 	enum class EKind { DTvec2, DTvec4, DTvec8, IBDTvec2, IBDTvec4, IBDTvec8, NTT2, NTT3, NTT3cpu, SBDTvec2, SBDTvec4, SBDTvec8 }; 
+	static const int packed_kind = -2;	// the kind of a context of packed digits, followed by the kind of the inner transform
+
+public:
+	// CPU transforms: double (DT), irrational base (IBDT), split double (SBDT) and number theoretic (NTT, i32 implementation)
+	enum class EFamily { Auto, DT, IBDT, SBDT, NTT };
 
 private:
 	const size_t _size;
 	const uint32_t _n;
-	const uint32_t _b;
+	uint32_t _b;
 	const EKind _kind;
+	size_t _max_multiplicands = 8;	// the multiplicands in addition to r_m
 
 protected:
 	virtual void getZi(int32_t * const zi) const = 0;
@@ -36,32 +46,81 @@ public:
 	virtual void mul() = 0;									// r_0 *= r_m
 
 	virtual void copy(const size_t dst, const size_t src) const = 0;	// r_dst = r_src
+	virtual void swap(const size_t r1, const size_t r2) = 0;			// r_1 <-> r_2, registers are renamed: no data is moved
+
+	// r_dst = r_src1 * r_src2, r_0 is unchanged if dst != 0
+	virtual void mulTo(const size_t dst, const size_t src1, const size_t src2)
+	{
+		if (dst == src1) initMultiplicand(src2);
+		else if (dst == src2) initMultiplicand(src1);
+		else { initMultiplicand(src2); copy(dst, src1); }
+		swap(0, dst); mul(); swap(0, dst);
+	}
+
+	// r_m is one of several transformed multiplicands, initMultiplicand and mul use the selected one.
+	// Returns false if the slot is not available (the default implementation has a single multiplicand).
+	virtual bool selectMultiplicand(const size_t slot) { return (slot == 0); }
+	// The slots 1, 2, ... are allocated when they are selected, at most max_multiplicands of them. The multiplicands are undefined.
+	virtual void setMaxMultiplicands(const size_t max_multiplicands) { _max_multiplicands = max_multiplicands; }
+	size_t getMaxMultiplicands() const { return _max_multiplicands; }
 
 	virtual size_t getMemSize() const = 0;
 	virtual size_t getCacheSize() const = 0;
+#if defined(GPU)
+	virtual size_t getMaxRegs() const = 0;	// the number of registers that can be allocated on the device
+#endif
+
+	virtual std::string getKindName() const
+	{
+		static const char * const names[] = { "DTvec2", "DTvec4", "DTvec8", "IBDTvec2", "IBDTvec4", "IBDTvec8", "NTT2", "NTT3", "NTT3cpu", "SBDTvec2", "SBDTvec4", "SBDTvec8" };
+		return names[static_cast<size_t>(_kind)];
+	}
 
 	virtual bool readContext(file & cFile, const size_t num_regs) = 0;
 	virtual void saveContext(file & cFile, const size_t num_regs) const = 0;
 
 	virtual double getError() const { return 0; }
+	virtual void resetError() {}
+	virtual void setCheckError(const bool) {}
+
+	// The transform is reused for a new base: twiddle factors are unchanged, r_i are undefined.
+	// The plan of the transform (see getPlan) must be the same for the new base.
+	virtual bool setBase(const uint32_t, const bool) { return false; }
+
+#if !defined(GPU)
+	// The OpenMP parallel regions are replaced with a persistent thread pool
+	virtual void setThreadPool(const threadPool::EWait) {}
+#endif
 
 private:
 #if defined(GPU)
 	static transform * create_ocl(const uint32_t b, const uint32_t n, const bool isBoinc, const size_t device, const size_t num_regs,
 								  const cl_platform_id boinc_platform_id, const cl_device_id boinc_device_id, const bool verbose);
 #elif defined(__aarch64__)
-	static transform * create_neon(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
+	static transform * create_neon(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
 #else
-	static transform * create_i32(const uint32_t b, const uint32_t n, const size_t num_regs);
-	static transform * create_sse2(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
-	static transform * create_sse4(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
-	static transform * create_avx(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
-	static transform * create_fma(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
+	static transform * create_i32(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs);
+	static transform * create_sse2(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
+	static transform * create_sse4(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
+	static transform * create_avx(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
+	static transform * create_fma(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
 #if defined(__x86_64)
-	static transform * create_512(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError);
+	static transform * create_512(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+								  const EFamily family);
 #endif	
+#endif
+#if !defined(GPU)
+	static transform * create_packed(const uint32_t b, const uint32_t n, transform * const pTransform);
 #endif
 
+	friend class transformBatch;
+	friend class transformPacked;
+
 protected:
 	static void * alignNew(const size_t size, const size_t alignment, const size_t offset = 0)
 	{
@@ -85,7 +144,9 @@ public:
 
 protected:
 	size_t getSize() const { return _size; }
+	uint32_t getN() const { return _n; }
 	uint32_t getB() const { return _b; }
+	void setB(const uint32_t b) { _b = b; }
 	EKind getKind() const { return _kind; }
 
 	static size_t bitRev(const size_t i, const size_t n)
@@ -105,49 +166,224 @@ public:
 		return pTransform;
 	}
 #else
-	static transform * create_cpu(const uint32_t b, const uint32_t n, const size_t num_threads, const std::string & impl, const size_t num_regs,
-								  const bool checkError, std::string & ttype)
+	static const char * familyName(const EFamily family)
+	{
+		static const char * const names[] = { "auto", "DT", "IBDT", "SBDT", "NTT" };
+		return names[static_cast<size_t>(family)];
+	}
+
+	// The largest b of the floating-point transforms, n = 12, ..., 23 (estimated with --limit if n >= 18).
+	// DT and SBDT are of size 2^{n-1}, IBDT is of size 2^n.
+	static uint32_t bMax(const EFamily family, const uint32_t n)
+	{
+		static constexpr uint32_t DT_b_max[23 - 12 + 1] = { 4200000, 3500000, 2800000, 2300000, 1900000, 1600000,
+															1550000, 1290000, 1060000, 868000, 846398, 520000 };
+		static constexpr uint32_t IBDT_b_max[23 - 12 + 1] = { 500000000, 380000000, 290000000, 220000000, 160000000, 125000000,
+															  94000000, 71000000, 54000000, 41000000, 31000000, 24000000 };
+		static constexpr uint32_t SBDT_b_max[23 - 12 + 1] = { 2000000000, 2000000000, 2000000000, 2000000000, 1500000000, 1000000000,
+															  1000000000, 1000000000, 650000000, 550000000, 450000000, 260000000 };
+		if (family == EFamily::NTT) return 2000000000;
+		if ((n < 12) || (n > 23)) return 0;
+		if (family == EFamily::DT) return DT_b_max[n - 12];
+		if (family == EFamily::IBDT) return IBDT_b_max[n - 12];
+		if (family == EFamily::SBDT) return SBDT_b_max[n - 12];
+		return 0;
+	}
+
+	// Time of a squaring in microseconds (fma implementation, one thread). Only the ratios are used.
+	static double cost(const EFamily family, const uint32_t n)
+	{
+		static constexpr double DT_cost[23 - 12 + 1] = { 40, 78, 124, 344, 719, 1600, 2370, 4630, 11500, 24600, 66800, 149000 };
+		static constexpr double IBDT_cost[23 - 12 + 1] = { 80, 166, 269, 692, 1460, 2700, 6360, 11000, 23000, 51000, 125000, 280000 };
+		static constexpr double SBDT_cost[23 - 12 + 1] = { 80, 161, 338, 501, 1360, 2430, 5870, 10500, 23000, 55000, 108000, 290000 };
+		if ((n < 12) || (n > 23)) return 0;
+		if (family == EFamily::DT) return DT_cost[n - 12];
+		if (family == EFamily::IBDT) return IBDT_cost[n - 12];
+		if (family == EFamily::SBDT) return SBDT_cost[n - 12];
+		return 0;
+	}
+
+	static bool isNTTAvailable()
+	{
+#if defined(__aarch64__)
+		return false;
+#else
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+
+	// The fastest floating-point transform such that b < b_max, the NTT if none is valid (SBDT if the NTT is not available).
+	// The family is fixed if it is not Auto or if a single family is compiled.
+	static EFamily selectFamily(const uint32_t b, const uint32_t n, const EFamily kind)
+	{
+		if (kind == EFamily::NTT) return kind;
+#if defined(DTRANSFORM)
+		(void)b; (void)n; return EFamily::DT;
+#elif defined(IBDTRANSFORM)
+		(void)b; (void)n; return EFamily::IBDT;
+#elif defined(SBDTRANSFORM)
+		(void)b; (void)n; return EFamily::SBDT;
+#else
+		if (kind != EFamily::Auto) return kind;
+
+		EFamily family = EFamily::NTT;
+		for (const EFamily f : { EFamily::DT, EFamily::IBDT, EFamily::SBDT })
+		{
+			if ((f == EFamily::DT) && (n >= 18) && (n <= 21)) continue;	// IBDT is the transform of n = 18, ..., 21
+			if ((b < bMax(f, n)) && ((family == EFamily::NTT) || (cost(f, n) < cost(family, n)))) family = f;
+		}
+		if ((family == EFamily::NTT) && !isNTTAvailable()) family = EFamily::SBDT;
+		return family;
+#endif
+	}
+
+	// The floating-point families of the build
+	static std::vector<EFamily> families()
+	{
+#if defined(DTRANSFORM)
+		return { EFamily::DT };
+#elif defined(IBDTRANSFORM)
+		return { EFamily::IBDT };
+#elif defined(SBDTRANSFORM)
+		return { EFamily::SBDT };
+#else
+		return { EFamily::DT, EFamily::IBDT, EFamily::SBDT };
+#endif
+	}
+
+	// Two digits are packed into a limb of base b^2 if the transform of (b^2, n - 1) is valid and faster than the transform of (b, n).
+	static bool packDigits(const uint32_t b, const uint32_t n, const EFamily kind)
+	{
+		if ((n < 13) || (uint64_t(b) * b > 2000000000)) return false;
+		const EFamily family = selectFamily(b, n, kind);
+		if (family == EFamily::NTT) return true;
+#if defined(DTRANSFORM) || defined(IBDTRANSFORM) || defined(SBDTRANSFORM)
+		return false;
+#else
+		const EFamily family2 = selectFamily(b * b, n - 1, kind);
+		return (family2 != EFamily::NTT) && (b * b < bMax(family2, n - 1)) && (cost(family2, n - 1) < cost(family, n));
+#endif
+	}
+
+	// The transform of (b, n): digits are packed or not and the family of the transform of (b, n) or (b^2, n - 1).
+	// The implementation i32 is the NTT.
+	struct plan
+	{
+		bool pack;
+		EFamily family;
+		bool operator==(const plan & rhs) const { return (pack == rhs.pack) && (family == rhs.family); }
+	};
+
+	static plan getPlan(const uint32_t b, const uint32_t n, const std::string & impl, const EFamily kind)
+	{
+		const EFamily k = (impl == "i32") ? EFamily::NTT : kind;
+		const bool pack = packDigits(b, n, k);
+		return plan{ pack, pack ? selectFamily(b * b, n - 1, k) : selectFamily(b, n, k) };
+	}
+
+	// The ratio of b (b^2 if digits are packed) to the limit of the transform: the round-off error is close to 1/2 if it is about 1.
+	static double bRatio(const uint32_t b, const uint32_t n, const plan & p)
+	{
+		if (p.family == EFamily::NTT) return 0;
+		const double b_eff = p.pack ? double(b) * b : double(b);
+		return b_eff / std::max(bMax(p.family, p.pack ? n - 1 : n), uint32_t(1));
+	}
+
+	// The safer transform of a plan whose round-off error is too large: the next floating-point family (DT -> IBDT -> SBDT)
+	// whose limit is larger than b, the NTT if none is valid and if it is available (AVX2), the widest family otherwise.
+	static bool escalatePlan(const uint32_t b, const uint32_t n, const plan & p, plan & next)
+	{
+		if (p.family == EFamily::NTT) return false;
+		bool found = false, wider = false;
+		for (const EFamily f : families())
+		{
+			if (wider)
+			{
+				next = plan{ p.pack, f }; found = true;
+				if (bRatio(b, n, next) < 1) return true;
+			}
+			if (f == p.family) wider = true;
+		}
+		if (isNTTAvailable()) { next = getPlan(b, n, "i32", EFamily::NTT); return true; }
+		return found;
+	}
+
+	// The plan of a raw context: its first field is the kind of the transform (and the kind of the inner transform if digits are packed).
+	static bool readPlan(file & cFile, plan & p)
 	{
+		int kind = 0;
+		if (!cFile.read(reinterpret_cast<char *>(&kind), sizeof(kind))) return false;
+		p.pack = (kind == packed_kind);
+		if (p.pack && !cFile.read(reinterpret_cast<char *>(&kind), sizeof(kind))) return false;
+		switch (static_cast<EKind>(kind))
+		{
+			case EKind::DTvec2: case EKind::DTvec4: case EKind::DTvec8: p.family = EFamily::DT; break;
+			case EKind::IBDTvec2: case EKind::IBDTvec4: case EKind::IBDTvec8: p.family = EFamily::IBDT; break;
+			case EKind::SBDTvec2: case EKind::SBDTvec4: case EKind::SBDTvec8: p.family = EFamily::SBDT; break;
+			case EKind::NTT3cpu: p.family = EFamily::NTT; break;
+			default: return false;
+		}
+		return true;
+	}
+
+	static transform * create_cpu(const uint32_t b, const uint32_t n, const size_t num_threads, const std::string & impl, const EFamily kind,
+								  const size_t num_regs, const bool checkError, std::string & ttype)
+	{
+		return create_cpu(b, n, num_threads, impl, getPlan(b, n, impl, kind), num_regs, checkError, ttype);
+	}
+
+	static transform * create_cpu(const uint32_t b, const uint32_t n, const size_t num_threads, const std::string & impl, const plan & p,
+								  const size_t num_regs, const bool checkError, std::string & ttype)
+	{
+		if (p.pack)
+		{
+			return create_packed(b, n, create_cpu(b * b, n - 1, num_threads, impl, plan{ false, p.family }, num_regs, checkError, ttype));
+		}
+		const EFamily family = p.family;
+
 		transform * pTransform = nullptr;
 
 #if defined(__aarch64__)
 		(void)impl;
-		pTransform = transform::create_neon(b, n, num_threads, num_regs, checkError);
+		if (family == EFamily::NTT) throw std::runtime_error("i32 is not supported");
+		pTransform = transform::create_neon(b, n, num_threads, num_regs, checkError, family);
 		ttype = "neon";
 #else
+		if (family == EFamily::NTT)
+		{
+			if (!isNTTAvailable()) throw std::runtime_error("i32 is not supported");
+			pTransform = transform::create_i32(b, n, num_threads, num_regs);
+			ttype = "i32";
+		}
+		else
 #if defined(__x86_64)
-		if (__builtin_cpu_supports("avx512f") && (impl.empty() || (impl == "512")))
+		     if (__builtin_cpu_supports("avx512f") && (impl.empty() || (impl == "512")))
 		{
-			pTransform = transform::create_512(b, n, num_threads, num_regs, checkError);
+			pTransform = transform::create_512(b, n, num_threads, num_regs, checkError, family);
 			ttype = "512";
 		}
 		else
 #endif
 		     if (__builtin_cpu_supports("fma") && (impl.empty() || (impl == "fma")))
 		{
-			pTransform = transform::create_fma(b, n, num_threads, num_regs, checkError);
+			pTransform = transform::create_fma(b, n, num_threads, num_regs, checkError, family);
 			ttype = "fma";
 		}
 		else if (__builtin_cpu_supports("avx") && (impl.empty() || (impl == "avx")))
 		{
-			pTransform = transform::create_avx(b, n, num_threads, num_regs, checkError);
+			pTransform = transform::create_avx(b, n, num_threads, num_regs, checkError, family);
 			ttype = "avx";
 		}
 		else if (__builtin_cpu_supports("sse4.1") && (impl.empty() || (impl == "sse4")))
 		{
-			pTransform = transform::create_sse4(b, n, num_threads, num_regs, checkError);
+			pTransform = transform::create_sse4(b, n, num_threads, num_regs, checkError, family);
 			ttype = "sse4";
 		}
 		else if (__builtin_cpu_supports("sse2") && (impl.empty() || (impl == "sse2")))
 		{
-			pTransform = transform::create_sse2(b, n, num_threads, num_regs, checkError);
+			pTransform = transform::create_sse2(b, n, num_threads, num_regs, checkError, family);
 			ttype = "sse2";
 		}
-		else if (__builtin_cpu_supports("avx2") && (impl.empty() || (impl == "i32")))
-		{
-			pTransform = transform::create_i32(b, n, num_regs);
-			ttype = "i32";
-		}
 		else
 		{
 			if (impl.empty()) throw std::runtime_error("processor must support sse2");
@@ -206,3 +442,140 @@ public:
 	// 	delete[] zi;
 	// }
 };
+
+#if !defined(GPU)
+// Independent numbers b_l^{2^n} + 1 are tested simultaneously, one per SIMD lane
+class transformBatch
+{
+private:
+	const uint32_t _n;
+	const size_t _lanes;
+	uint32_t _b[8];
+
+protected:
+	virtual void getZi(const size_t lane, int32_t * const zi) const = 0;
+	virtual void setZi(const size_t lane, const int32_t * const zi) = 0;
+
+public:
+	virtual void set(const int32_t a) = 0;					// r_0 = a
+	virtual void squareDup(const uint32_t dup) = 0;			// r_0 = r_0^2 or 2*r_0^2 if bit #lane of dup is set
+	virtual void initMultiplicand(const size_t src) = 0;	// r_m = transform(r_src)
+	virtual void mul() = 0;									// r_0 *= r_m
+	virtual void mulTo(const size_t dst, const size_t src1, const size_t src2) = 0;	// r_dst = r_src1 * r_src2
+
+	virtual void copy(const size_t dst, const size_t src) const = 0;	// r_dst = r_src
+
+	virtual size_t getMemSize() const = 0;
+	virtual size_t getCacheSize() const = 0;
+
+	virtual double getError(const size_t) const { return 0; }	// the round-off error of a lane
+	virtual void setCheckError(const bool) {}
+
+private:
+#if !defined(__aarch64__)
+	static transformBatch * create_sse2(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError);
+	static transformBatch * create_sse4(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError);
+	static transformBatch * create_avx(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError);
+	static transformBatch * create_fma(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError);
+#if defined(__x86_64)
+	static transformBatch * create_512(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError);
+#endif
+#endif
+
+protected:
+	static void * alignNew(const size_t size, const size_t alignment) { return transform::alignNew(size, alignment); }
+	static void alignDelete(void * const ptr) { transform::alignDelete(ptr); }
+
+public:
+	transformBatch(const uint32_t n, const size_t lanes, const uint32_t * const b) : _n(n), _lanes(lanes)
+	{
+		for (size_t l = 0; l < lanes; ++l) _b[l] = b[l];
+	}
+	virtual ~transformBatch() {}
+
+	size_t getLanes() const { return _lanes; }
+
+	// Number of lanes of the implementation, 0 if the batch mode is not supported
+	static size_t lanes(const std::string & impl)
+	{
+#if defined(CYCLO) || defined(__aarch64__)
+		(void)impl;
+		return 0;
+#else
+#if defined(__x86_64)
+		if (__builtin_cpu_supports("avx512f") && (impl.empty() || (impl == "512"))) return 8;
+#endif
+		if (__builtin_cpu_supports("fma") && (impl.empty() || (impl == "fma"))) return 4;
+		if (__builtin_cpu_supports("avx") && (impl.empty() || (impl == "avx"))) return 4;
+		if (__builtin_cpu_supports("sse4.1") && (impl.empty() || (impl == "sse4"))) return 2;
+		if (__builtin_cpu_supports("sse2") && (impl.empty() || (impl == "sse2"))) return 2;
+		return 0;
+#endif
+	}
+
+	// b is an array of lanes(impl) bases
+	static transformBatch * create_cpu(const uint32_t * const b, const uint32_t n, const std::string & impl, const size_t num_regs,
+									   const bool checkError, std::string & ttype)
+	{
+		transformBatch * pTransform = nullptr;
+#if defined(__aarch64__)
+		(void)b; (void)n; (void)impl; (void)num_regs; (void)checkError; (void)ttype;
+#else
+#if defined(__x86_64)
+		if (__builtin_cpu_supports("avx512f") && (impl.empty() || (impl == "512")))
+		{
+			pTransform = transformBatch::create_512(b, n, num_regs, checkError);
+			ttype = "512";
+		}
+		else
+#endif
+		     if (__builtin_cpu_supports("fma") && (impl.empty() || (impl == "fma")))
+		{
+			pTransform = transformBatch::create_fma(b, n, num_regs, checkError);
+			ttype = "fma";
+		}
+		else if (__builtin_cpu_supports("avx") && (impl.empty() || (impl == "avx")))
+		{
+			pTransform = transformBatch::create_avx(b, n, num_regs, checkError);
+			ttype = "avx";
+		}
+		else if (__builtin_cpu_supports("sse4.1") && (impl.empty() || (impl == "sse4")))
+		{
+			pTransform = transformBatch::create_sse4(b, n, num_regs, checkError);
+			ttype = "sse4";
+		}
+		else if (__builtin_cpu_supports("sse2") && (impl.empty() || (impl == "sse2")))
+		{
+			pTransform = transformBatch::create_sse2(b, n, num_regs, checkError);
+			ttype = "sse2";
+		}
+#endif
+		if (pTransform == nullptr) throw std::runtime_error("batch mode is not supported");
+		return pTransform;
+	}
+
+	void mul(const size_t src)
+	{
+		initMultiplicand(src);
+		mul();
+	}
+
+	void getInt(gint & g, const size_t lane) const
+	{
+		if ((g.getSize() != (size_t(1) << _n)) || (g.getBase() != _b[lane])) throw std::runtime_error("getInt");
+		getZi(lane, g.data());
+		g.reset();
+	}
+
+	void setInt(gint & g, const size_t lane)
+	{
+		if ((g.getSize() != (size_t(1) << _n)) || (g.getBase() != _b[lane])) throw std::runtime_error("setInt");
+		g.balance();
+		setZi(lane, g.data());
+	}
+};
+#endif
+
+#if !defined(GPU)
+#include "transformPacked.h"
+#endif
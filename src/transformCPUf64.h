@@ -9,6 +9,7 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #include <cstdint>
 #include <cmath>
+#include <vector>
 
 #include <gmp.h>
 #include <omp.h>
@@ -266,15 +267,24 @@ private:
 	static const size_t zrOffset = zpOffset + zSize;
 
 	const size_t _num_threads;
-	const double _b, _b_inv, _sb, _sb_inv;
+	double _b, _b_inv, _sb, _sb_inv;
 	const size_t _mem_size, _cache_size;
 	double _sbh, _sbl;
 	bool _checkError;
 	double _error;
+	threadPool * _pool = nullptr;
 	char * const _mem;
+	size_t * const _reg;	// logical to physical registers
 	Vc * const _z_copy;
+	std::vector<Vc *> _zp_slots;	// multiplicands #1, #2, ...
+	size_t _zp_index = 0;
 
 private:
+	// physical register #0 is at zOffset, the others at zrOffset
+	finline Vc * reg(const size_t r) const { const size_t p = _reg[r]; return (Vc *)&_mem[(p == 0) ? zOffset : zrOffset + (p - 1) * zSize]; }
+	// multiplicand #0 is at zpOffset
+	finline Vc * zp() const { return (_zp_index == 0) ? (Vc *)&_mem[zpOffset] : _zp_slots[_zp_index - 1]; }
+
 	finline static void forward_out(Vc * const z, const Complex * const w122i)
 	{
 		static const size_t stepi = index(n_io) / VSIZE;
@@ -324,7 +334,7 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const z = (Vc *)&_mem[zOffset];
+		Vc * const z = reg(0);
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -435,7 +445,7 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const zp = (Vc *)&_mem[zpOffset];
+		Vc * const zp = this->zp();
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -498,8 +508,8 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const z = (Vc *)&_mem[zOffset];
-		const Vc * const zp = (Vc *)&_mem[zpOffset];
+		Vc * const z = reg(0);
+		const Vc * const zp = this->zp();
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -603,7 +613,7 @@ private:
 	double pass2_0(const size_t thread_id, const bool dup)
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
-		Vc * const z = (Vc *)&_mem[zOffset];
+		Vc * const z = reg(0);
 		Vc * const fc = (Vc *)&_mem[fcOffset]; Vc * const f = &fc[thread_id * n_io_inv];
 		const double b = _b, b_inv = _b_inv, sb = _sb, sb_inv = _sb_inv, sbh = _sbh, sbl = _sbl, g = dup ? 2.0 : 1.0;
 		const bool checkError = _checkError;
@@ -652,7 +662,7 @@ private:
 		const size_t thread_id_prev = ((thread_id != 0) ? thread_id : num_threads) - 1;
 		const size_t lh = thread_id * n_io_s / num_threads;	// l_min of pass2
 
-		Vc * const z = (Vc *)&_mem[zOffset]; Vc * const zl = &z[2 * 4 / VSIZE * lh];
+		Vc * const z = reg(0); Vc * const zl = &z[2 * 4 / VSIZE * lh];
 		const Vc * const fc = (Vc *)&_mem[fcOffset]; const Vc * const f = &fc[thread_id_prev * n_io_inv];
 
 		const double b = _b, b_inv = _b_inv, sb = _sb, sb_inv = _sb_inv, sbh = _sbh, sbl = _sbl;
@@ -680,21 +690,12 @@ public:
 		: transform(N, n, b, IBASE ? ((VSIZE == 2) ? EKind::IBDTvec2 : ((VSIZE == 4) ? EKind::IBDTvec4 : EKind::IBDTvec8))
 								   : ((VSIZE == 2) ? EKind::DTvec2 : ((VSIZE == 4) ? EKind::DTvec4 : EKind::DTvec8))),
 		_num_threads(num_threads),
-		_b(b), _b_inv(1.0 / b), _sb(sqrt(static_cast<double>(b))), _sb_inv(1 / _sb),
 		_mem_size(wSize + wsSize + zSize + fcSize + zSize + (num_regs - 1) * zSize + 2 * 1024 * 1024),
 		_cache_size(wSize + wsSize + zSize + fcSize), _checkError(checkError), _error(0),
-		_mem((char *)alignNew(_mem_size, 2 * 1024 * 1024)), _z_copy((Vc *)alignNew(zSize, 1024))
+		_mem((char *)alignNew(_mem_size, 2 * 1024 * 1024)), _reg(new size_t[num_regs]), _z_copy((Vc *)alignNew(zSize, 1024))
 	{
-		mpz_t sb2e64, t; mpz_init_set_ui(sb2e64, b); mpz_init(t);
-		mpz_mul_2exp(sb2e64, sb2e64, 128); mpz_sqrt(sb2e64, sb2e64);
-
-		const int shift = 16;
-		mpz_div_2exp(t, sb2e64, 64 - shift);
-		_sbh = std::ldexp(mpz_get_d(t), -shift);
-		mpz_mod_2exp(t, sb2e64, 64 - shift);
-		_sbl = std::ldexp(mpz_get_d(t), -64);
-
-		mpz_clear(sb2e64); mpz_clear(t);
+		initBase(b);
+		for (size_t r = 0; r < num_regs; ++r) _reg[r] = r;
 
 		const size_t a =
 #if defined(CYCLO)
@@ -728,17 +729,51 @@ public:
 
 	virtual ~transformCPUf64()
 	{
+		delete _pool;
 		alignDelete((void *)_mem);
+		delete[] _reg;
 		alignDelete((void *)_z_copy);
+		for (Vc * const zp : _zp_slots) alignDelete((void *)zp);
 	}
 
-	size_t getMemSize() const override { return _mem_size; }
+	size_t getMemSize() const override { return _mem_size + _zp_slots.size() * zSize; }
 	size_t getCacheSize() const override { return _cache_size; }
 
+	bool setBase(const uint32_t b, const bool checkError) override
+	{
+		setB(b);
+		initBase(b);
+		_checkError = checkError; _error = 0;
+		return true;
+	}
+
+	void setThreadPool(const threadPool::EWait wait) override
+	{
+		delete _pool; _pool = nullptr;
+		if (_num_threads > 1) _pool = new threadPool(_num_threads, wait);
+	}
+
+private:
+	void initBase(const uint32_t b)
+	{
+		_b = b; _b_inv = 1.0 / b; _sb = sqrt(static_cast<double>(b)); _sb_inv = 1 / _sb;
+
+		mpz_t sb2e64, t; mpz_init_set_ui(sb2e64, b); mpz_init(t);
+		mpz_mul_2exp(sb2e64, sb2e64, 128); mpz_sqrt(sb2e64, sb2e64);
+
+		const int shift = 16;
+		mpz_div_2exp(t, sb2e64, 64 - shift);
+		_sbh = std::ldexp(mpz_get_d(t), -shift);
+		mpz_mod_2exp(t, sb2e64, 64 - shift);
+		_sbl = std::ldexp(mpz_get_d(t), -64);
+
+		mpz_clear(sb2e64); mpz_clear(t);
+	}
+
 protected:
 	void getZi(int32_t * const zi) const override
 	{
-		const Vc * const z = (Vc *)&_mem[zOffset];
+		const Vc * const z = reg(0);
 
 		Vc * const z_copy = _z_copy;
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) z_copy[k] = z[k];
@@ -783,7 +818,7 @@ protected:
 
 	void setZi(const int32_t * const zi) override
 	{
-		Vc * const z = (Vc *)&_mem[zOffset];
+		Vc * const z = reg(0);
 
 		if (IBASE)
 		{
@@ -841,12 +876,9 @@ public:
 
 		if (!cFile.read(reinterpret_cast<char *>(&_error), sizeof(_error))) return false;
 
-		Vc * const z = (Vc *)&_mem[zOffset];
-		if (!cFile.read(reinterpret_cast<char *>(z), zSize)) return false;
-		if (num_regs > 1)
+		for (size_t r = 0, nr = std::max(num_regs, size_t(1)); r < nr; ++r)
 		{
-			Vc * const zr = (Vc *)&_mem[zrOffset];
-			if (!cFile.read(reinterpret_cast<char *>(zr), (num_regs - 1) * zSize)) return false;
+			if (!cFile.read(reinterpret_cast<char *>(reg(r)), zSize)) return false;
 		}
 
 		return true;
@@ -859,18 +891,15 @@ public:
 
 		if (!cFile.write(reinterpret_cast<const char *>(&_error), sizeof(_error))) return;
 
-		const Vc * const z = (Vc *)&_mem[zOffset];
-		if (!cFile.write(reinterpret_cast<const char *>(z), zSize)) return;
-		if (num_regs > 1)
+		for (size_t r = 0, nr = std::max(num_regs, size_t(1)); r < nr; ++r)
 		{
-			const Vc * const zr = (Vc *)&_mem[zrOffset];
-			if (!cFile.write(reinterpret_cast<const char *>(zr), (num_regs - 1) * zSize)) return;
+			if (!cFile.write(reinterpret_cast<const char *>(reg(r)), zSize)) return;
 		}
 	}
 
 	void set(const int32_t a) override
 	{
-		Vc * const z = (Vc *)&_mem[zOffset];
+		Vc * const z = reg(0);
 		z[0] = Vc(a);
 		for (size_t k = 1; k < index(N) / VSIZE; ++k) z[k] = Vc(0.0);
 
@@ -886,7 +915,20 @@ public:
 		const size_t num_threads = _num_threads;
 		double e[num_threads];
 
-		if (num_threads > 1)
+		if (_pool != nullptr)
+		{
+			threadPool & pool = *_pool;
+			double * const pe = e;
+			pool.run([&](const size_t thread_id)
+			{
+				pass1(thread_id);
+				pool.barrier(thread_id);
+				pe[thread_id] = pass2_0(thread_id, dup);
+				pool.barrier(thread_id);
+				pass2_1(thread_id);
+			});
+		}
+		else if (num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -913,11 +955,15 @@ public:
 
 	void initMultiplicand(const size_t src) override
 	{
-		const Vc * const z_src = (Vc *)&_mem[(src == 0) ? zOffset : zrOffset + (src - 1) * zSize];
-		Vc * const zp = (Vc *)&_mem[zpOffset];
+		const Vc * const z_src = reg(src);
+		Vc * const zp = this->zp();
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zp[k] = z_src[k];
 
-		if (_num_threads > 1)
+		if (_pool != nullptr)
+		{
+			_pool->run([&](const size_t thread_id) { pass1multiplicand(thread_id); });
+		}
+		else if (_num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -936,7 +982,20 @@ public:
 		const size_t num_threads = _num_threads;
 		double e[num_threads];
 
-		if (num_threads > 1)
+		if (_pool != nullptr)
+		{
+			threadPool & pool = *_pool;
+			double * const pe = e;
+			pool.run([&](const size_t thread_id)
+			{
+				pass1mul(thread_id);
+				pool.barrier(thread_id);
+				pe[thread_id] = pass2_0(thread_id, false);
+				pool.barrier(thread_id);
+				pass2_1(thread_id);
+			});
+		}
+		else if (num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -963,57 +1022,73 @@ public:
 
 	void copy(const size_t dst, const size_t src) const override
 	{
-		const Vc * const z_src = (Vc *)&_mem[(src == 0) ? zOffset : zrOffset + (src - 1) * zSize];
-		Vc * const z_dst = (Vc *)&_mem[(dst == 0) ? zOffset : zrOffset + (dst - 1) * zSize];
+		const Vc * const z_src = reg(src);
+		Vc * const z_dst = reg(dst);
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) z_dst[k] = z_src[k];
 	}
 
+	void swap(const size_t r1, const size_t r2) override { std::swap(_reg[r1], _reg[r2]); }
+
+	bool selectMultiplicand(const size_t slot) override
+	{
+		if (slot > getMaxMultiplicands()) return false;
+		while (_zp_slots.size() < slot) _zp_slots.push_back((Vc *)alignNew(zSize, 1024));
+		_zp_index = slot;
+		return true;
+	}
+
+	void setMaxMultiplicands(const size_t max_multiplicands) override
+	{
+		transform::setMaxMultiplicands(max_multiplicands);
+		while (_zp_slots.size() > max_multiplicands) { alignDelete((void *)_zp_slots.back()); _zp_slots.pop_back(); }
+		_zp_index = 0;
+	}
+
 	double getError() const override { return _error; }
+	void resetError() override { _error = 0; }
+	void setCheckError(const bool checkError) override { _checkError = checkError; }
 };
 
 template<size_t VSIZE>
-inline transform * create_transformCPUf64(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError)
+inline transform * create_transformCPUf64(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError, const bool ibdt)
 {
 	transform * pTransform = nullptr;
-#if defined(DTRANSFORM)
-	if      (n == 12) pTransform = new transformCPUf64<(1 << 11), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 13) pTransform = new transformCPUf64<(1 << 12), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 14) pTransform = new transformCPUf64<(1 << 13), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 15) pTransform = new transformCPUf64<(1 << 14), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 16) pTransform = new transformCPUf64<(1 << 15), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 17) pTransform = new transformCPUf64<(1 << 16), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 18) pTransform = new transformCPUf64<(1 << 17), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 19) pTransform = new transformCPUf64<(1 << 18), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 20) pTransform = new transformCPUf64<(1 << 19), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 21) pTransform = new transformCPUf64<(1 << 20), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 22) pTransform = new transformCPUf64<(1 << 21), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-	else if (n == 23) pTransform = new transformCPUf64<(1 << 22), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-#elif defined(IBDTRANSFORM)
-	if      (n == 12) pTransform = new transformCPUf64<(1 << 12), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 13) pTransform = new transformCPUf64<(1 << 13), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 14) pTransform = new transformCPUf64<(1 << 14), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 15) pTransform = new transformCPUf64<(1 << 15), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 16) pTransform = new transformCPUf64<(1 << 16), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 17) pTransform = new transformCPUf64<(1 << 17), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 18) pTransform = new transformCPUf64<(1 << 18), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 19) pTransform = new transformCPUf64<(1 << 19), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 20) pTransform = new transformCPUf64<(1 << 20), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 21) pTransform = new transformCPUf64<(1 << 21), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 22) pTransform = new transformCPUf64<(1 << 22), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 23) pTransform = new transformCPUf64<(1 << 23), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-#elif defined(SBDTRANSFORM)
-	(void)b; (void)n; (void)num_threads; (void)num_regs; (void)checkError;
-#else
-	if      (n == 18) pTransform = new transformCPUf64<(1 << 18), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 19) pTransform = new transformCPUf64<(1 << 19), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 20) pTransform = new transformCPUf64<(1 << 20), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 21) pTransform = new transformCPUf64<(1 << 21), VSIZE, true>(b, n, num_threads, num_regs, checkError);
-	else if (n == 22)
+#if !defined(IBDTRANSFORM) && !defined(SBDTRANSFORM)
+	if (!ibdt)
 	{
-		if (b < 846398) pTransform = new transformCPUf64<(1 << 21), VSIZE, false>(b, n, num_threads, num_regs, checkError);
-		else            pTransform = new transformCPUf64<(1 << 22), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		if      (n == 12) pTransform = new transformCPUf64<(1 << 11), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 13) pTransform = new transformCPUf64<(1 << 12), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 14) pTransform = new transformCPUf64<(1 << 13), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 15) pTransform = new transformCPUf64<(1 << 14), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 16) pTransform = new transformCPUf64<(1 << 15), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 17) pTransform = new transformCPUf64<(1 << 16), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 18) pTransform = new transformCPUf64<(1 << 17), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 19) pTransform = new transformCPUf64<(1 << 18), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 20) pTransform = new transformCPUf64<(1 << 19), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 21) pTransform = new transformCPUf64<(1 << 20), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 22) pTransform = new transformCPUf64<(1 << 21), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+		else if (n == 23) pTransform = new transformCPUf64<(1 << 22), VSIZE, false>(b, n, num_threads, num_regs, checkError);
 	}
-	else if (n == 23) pTransform = new transformCPUf64<(1 << 22), VSIZE, false>(b, n, num_threads, num_regs, checkError);
+#endif
+#if !defined(DTRANSFORM) && !defined(SBDTRANSFORM)
+	if (ibdt)
+	{
+		if      (n == 12) pTransform = new transformCPUf64<(1 << 12), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 13) pTransform = new transformCPUf64<(1 << 13), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 14) pTransform = new transformCPUf64<(1 << 14), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 15) pTransform = new transformCPUf64<(1 << 15), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 16) pTransform = new transformCPUf64<(1 << 16), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 17) pTransform = new transformCPUf64<(1 << 17), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 18) pTransform = new transformCPUf64<(1 << 18), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 19) pTransform = new transformCPUf64<(1 << 19), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 20) pTransform = new transformCPUf64<(1 << 20), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 21) pTransform = new transformCPUf64<(1 << 21), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 22) pTransform = new transformCPUf64<(1 << 22), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+		else if (n == 23) pTransform = new transformCPUf64<(1 << 23), VSIZE, true>(b, n, num_threads, num_regs, checkError);
+	}
+#endif
+#if defined(SBDTRANSFORM)
+	(void)b; (void)n; (void)num_threads; (void)num_regs; (void)checkError; (void)ibdt;
 #endif
 
 	if (pTransform == nullptr) throw std::runtime_error("exponent is not supported");
@@ -0,0 +1,272 @@
+/*
+Copyright 2022, Yves Gallot
+
+genefer is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+#include "transform.h"
+#include "f64vector.h"
+
+namespace transformCPU_namespace
+{
+
+// VSIZE numbers b_l^{2N} + 1 are processed simultaneously, number l is stored in lane l of the vectors.
+// Right-angle convolution: z_k = a_k + i a_{k + N}, the product is computed modulo y^N - i.
+// A radix-4 step splits y^{4m} - w0^2 into y^m - w1, y^m + w1, y^m - i w1 and y^m + i w1 where w1^2 = w0.
+template<size_t N, size_t VSIZE>
+class transformCPUf64b : public transformBatch
+{
+	using Vc = Vcx<VSIZE>;
+	using Vr = Vd<VSIZE>;
+	using Vr4 = Vradix4<VSIZE>;
+
+private:
+	static const size_t zSize = N * sizeof(Vc);
+	static const size_t wSize = 2 * N * sizeof(Complex);
+
+	Vr _b, _b_inv;
+	const size_t _mem_size, _cache_size;
+	bool _checkError;
+	Vr _error;	// the round-off error of each lane
+	char * const _mem;
+	Complex * const _w;
+	Vc * const _zp;
+	Vc * const _z;
+
+private:
+	// Twiddle factors of the step with s blocks are w[2 * (s - 1) / 3], in tangent form (see Vradix4).
+	// The roots of the odd blocks are w0 = i w0', w0' is stored and the radix-4 step is forward4o / backward4o.
+	static void forward(Vc * const z, const Complex * const w)
+	{
+		size_t s = 1;
+		for (size_t m = N / 4; m >= 1; m /= 4, s *= 4)
+		{
+			const Complex * const w_s = &w[2 * (s - 1) / 3];
+			for (size_t j = 0; j < s; ++j)
+			{
+				const Vc w0 = Vc::broadcast(w_s[2 * j + 0]), w1 = Vc::broadcast(w_s[2 * j + 1]);
+				Vc * const zj = &z[4 * m * j];
+				if (j % 2 == 0) Vr4::forward4e(m, zj, w0, w1); else Vr4::forward4o(m, zj, w0, w1);
+			}
+		}
+
+		if (s != N)
+		{
+			const Complex * const w_s = &w[2 * (s - 1) / 3];
+			for (size_t j = 0; j < s; ++j)
+			{
+				const Vc u0 = z[2 * j + 0], u1 = z[2 * j + 1].mulW(Vc::broadcast(w_s[j]));
+				if (j % 2 == 0) { z[2 * j + 0] = u0 + u1; z[2 * j + 1] = u0 - u1; }
+				else { z[2 * j + 0] = u0.addi(u1); z[2 * j + 1] = u0.subi(u1); }
+			}
+		}
+	}
+
+	// The result is multiplied by N
+	static void backward(Vc * const z, const Complex * const w)
+	{
+		size_t m = 1;
+		if (ilog2(N) % 2 != 0)
+		{
+			const size_t s = N / 2;
+			const Complex * const w_s = &w[2 * (s - 1) / 3];
+			for (size_t j = 0; j < s; ++j)
+			{
+				const Vc u0 = z[2 * j + 0], u1 = z[2 * j + 1], ws = Vc::broadcast(w_s[j]);
+				z[2 * j + 0] = u0 + u1;
+				z[2 * j + 1] = ((j % 2 == 0) ? Vc(u0 - u1) : u1.sub_i(u0)).mulWconj(ws);
+			}
+			m = 2;
+		}
+
+		for (; m <= N / 4; m *= 4)
+		{
+			const size_t s = N / (4 * m);
+			const Complex * const w_s = &w[2 * (s - 1) / 3];
+			for (size_t j = 0; j < s; ++j)
+			{
+				const Vc w0 = Vc::broadcast(w_s[2 * j + 0]), w1 = Vc::broadcast(w_s[2 * j + 1]);
+				Vc * const zj = &z[4 * m * j];
+				if (j % 2 == 0) Vr4::backward4e(m, zj, w0, w1); else Vr4::backward4o(m, zj, w0, w1);
+			}
+		}
+	}
+
+	static constexpr size_t ilog2(const size_t n) { return (n <= 1) ? 0 : 1 + ilog2(n / 2); }
+
+	// g is 1 or 2 in each lane: the result is multiplied by g
+	void carry(Vc * const z, const Vr & g)
+	{
+		const Vr b = _b, b_inv = _b_inv, n_inv = Vr::broadcast(1.0 / N), zero = Vr::broadcast(0.0);
+
+		Vr err = zero, fr = zero, fi = zero;
+		for (size_t k = 0; k < N; ++k)
+		{
+			const Vr xr = z[k].real() * n_inv, xi = z[k].imag() * n_inv;
+			const Vr rr = xr.round(), ri = xi.round();
+			if (_checkError) { err.max(Vr(xr - rr).abs()); err.max(Vr(xi - ri).abs()); }
+			fr += rr * g; fi += ri * g;
+			const Vr qr = Vr(fr * b_inv).round(), qi = Vr(fi * b_inv).round();
+			z[k] = Vc(fr - qr * b, fi - qi * b);
+			fr = qr; fi = qi;
+		}
+		if (_checkError) _error.max(err);
+
+		// a_{N - 1} carry is added to a_N and a_{2N - 1} carry is subtracted from a_0
+		while (!fr.isZero() || !fi.isZero())
+		{
+			Vr cr = zero - fi, ci = fr;
+			for (size_t k = 0; k < N; ++k)
+			{
+				cr += z[k].real(); ci += z[k].imag();
+				const Vr qr = Vr(cr * b_inv).round(), qi = Vr(ci * b_inv).round();
+				z[k] = Vc(cr - qr * b, ci - qi * b);
+				cr = qr; ci = qi;
+				if (cr.isZero() && ci.isZero()) break;
+			}
+			fr = cr; fi = ci;
+		}
+	}
+
+	void mul(Vc * const z)
+	{
+		const Vc * const zp = _zp;
+		forward(z, _w);
+		for (size_t k = 0; k < N; ++k) z[k] = z[k] * zp[k];
+		backward(z, _w);
+		carry(z, Vr::broadcast(1.0));
+	}
+
+public:
+	transformCPUf64b(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError)
+		: transformBatch(n, VSIZE, b),
+		_mem_size(wSize + (num_regs + 1) * zSize), _cache_size(wSize + 2 * zSize), _checkError(checkError), _error(Vr::broadcast(0.0)),
+		_mem((char *)alignNew(_mem_size, 1024)), _w((Complex *)&_mem[0]), _zp((Vc *)&_mem[wSize]), _z((Vc *)&_mem[wSize + zSize])
+	{
+		for (size_t l = 0; l < VSIZE; ++l) { _b.set(l, static_cast<double>(b[l])); _b_inv.set(l, 1.0 / b[l]); }
+
+		// root is i = exp(2i pi N / 4N), the angle of the root theta is 2 pi theta / 8N
+		size_t * const theta = new size_t[N];
+		theta[0] = N;
+		size_t s = 1;
+		for (size_t m = N / 4; m >= 1; m /= 4, s *= 4)
+		{
+			Complex * const w_s = &_w[2 * (s - 1) / 3];
+			for (size_t j = s; j > 0; --j)
+			{
+				const size_t t = theta[j - 1];
+				w_s[2 * (j - 1) + 0] = Complex::exp2iPi(((j - 1) % 2 == 0) ? t : t - 2 * N, 8 * N);
+				w_s[2 * (j - 1) + 1] = Complex::exp2iPi(t, 16 * N);
+				theta[4 * (j - 1) + 0] = t / 4; theta[4 * (j - 1) + 1] = t / 4 + 2 * N;
+				theta[4 * (j - 1) + 2] = t / 4 + N; theta[4 * (j - 1) + 3] = t / 4 + 3 * N;
+			}
+		}
+		if (s != N)
+		{
+			Complex * const w_s = &_w[2 * (s - 1) / 3];
+			for (size_t j = 0; j < s; ++j) w_s[j] = Complex::exp2iPi((j % 2 == 0) ? theta[j] : theta[j] - 2 * N, 8 * N);
+		}
+		delete[] theta;
+	}
+
+	virtual ~transformCPUf64b()
+	{
+		alignDelete((void *)_mem);
+	}
+
+	size_t getMemSize() const override { return _mem_size; }
+	size_t getCacheSize() const override { return _cache_size; }
+
+protected:
+	void getZi(const size_t lane, int32_t * const zi) const override
+	{
+		const Vc * const z = _z;
+		for (size_t k = 0; k < N; ++k)
+		{
+			const Complex zc = z[k][lane];
+			zi[k + 0 * N] = static_cast<int32_t>(std::lround(zc.real));
+			zi[k + 1 * N] = static_cast<int32_t>(std::lround(zc.imag));
+		}
+	}
+
+	void setZi(const size_t lane, const int32_t * const zi) override
+	{
+		Vc * const z = _z;
+		for (size_t k = 0; k < N; ++k) z[k].set(lane, Complex(static_cast<double>(zi[k + 0 * N]), static_cast<double>(zi[k + 1 * N])));
+	}
+
+public:
+	void set(const int32_t a) override
+	{
+		Vc * const z = _z;
+		z[0] = Vc::broadcast(Complex(static_cast<double>(a), 0.0));
+		for (size_t k = 1; k < N; ++k) z[k] = Vc::broadcast(Complex(0.0, 0.0));
+	}
+
+	void squareDup(const uint32_t dup) override
+	{
+		Vc * const z = _z;
+		forward(z, _w);
+		for (size_t k = 0; k < N; ++k) z[k] = z[k].sqr();
+		backward(z, _w);
+		Vr g; for (size_t l = 0; l < VSIZE; ++l) g.set(l, ((dup >> l) & 1) ? 2.0 : 1.0);
+		carry(z, g);
+	}
+
+	void initMultiplicand(const size_t src) override
+	{
+		Vc * const zp = _zp;
+		const Vc * const zsrc = &_z[src * N];
+		for (size_t k = 0; k < N; ++k) zp[k] = zsrc[k];
+		forward(zp, _w);
+	}
+
+	void mul() override { mul(_z); }
+
+	// r_0 and r_m are unchanged if dst != 0 and the register is multiplied in place if dst is a source
+	void mulTo(const size_t dst, const size_t src1, const size_t src2) override
+	{
+		if (dst == src1) initMultiplicand(src2);
+		else if (dst == src2) initMultiplicand(src1);
+		else { initMultiplicand(src2); copy(dst, src1); }
+		mul(&_z[dst * N]);
+	}
+
+	void copy(const size_t dst, const size_t src) const override
+	{
+		const Vc * const zsrc = &_z[src * N];
+		Vc * const zdst = &_z[dst * N];
+		for (size_t k = 0; k < N; ++k) zdst[k] = zsrc[k];
+	}
+
+	double getError(const size_t lane) const override { return _error[lane]; }
+	void setCheckError(const bool checkError) override { _checkError = checkError; }
+};
+
+template<size_t VSIZE>
+inline transformBatch * create_transformCPUf64b(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError)
+{
+	transformBatch * pTransform = nullptr;
+#if defined(CYCLO)
+	(void)b; (void)n; (void)num_regs; (void)checkError;
+#else
+	if      (n == 12) pTransform = new transformCPUf64b<(1 << 11), VSIZE>(b, n, num_regs, checkError);
+	else if (n == 13) pTransform = new transformCPUf64b<(1 << 12), VSIZE>(b, n, num_regs, checkError);
+	else if (n == 14) pTransform = new transformCPUf64b<(1 << 13), VSIZE>(b, n, num_regs, checkError);
+	else if (n == 15) pTransform = new transformCPUf64b<(1 << 14), VSIZE>(b, n, num_regs, checkError);
+	else if (n == 16) pTransform = new transformCPUf64b<(1 << 15), VSIZE>(b, n, num_regs, checkError);
+#endif
+
+	if (pTransform == nullptr) throw std::runtime_error("exponent is not supported");
+
+	return pTransform;
+}
+
+}
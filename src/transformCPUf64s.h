@@ -9,6 +9,7 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #include <cstdint>
 #include <cmath>
+#include <vector>
 
 #include <omp.h>
 
@@ -17,7 +18,6 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 namespace transformCPU_namespace
 {
-	static constexpr double split = 1 << 20, split_inv = 1.0 / split;
 
 template<size_t N>
 class Vcx8s
@@ -179,7 +179,7 @@ public:
 		bwdo(w);
 	}
 
-	finline void mul_carry(const Vc & fl_prev, const Vc & fh_prev, Vc & fl_new, Vc & fh_new, const double g, const double b, const double b_inv, const double t2_n)
+	finline void mul_carry(const Vc & fl_prev, const Vc & fh_prev, Vc & fl_new, Vc & fh_new, const double g, const double b, const double b_inv, const double t2_n, const double split, const double split_inv)
 	{
 		Vc fl = fl_prev, fh = fh_prev;
 
@@ -204,7 +204,7 @@ public:
 		fl_new = fl; fh_new = fh;
 	}
 
-	finline void mul_carry(const Vc & fl_prev, const Vc & fh_prev, Vc & fl_new, Vc & fh_new, const double g, const double b, const double b_inv, const double t2_n, Vc & err)
+	finline void mul_carry(const Vc & fl_prev, const Vc & fh_prev, Vc & fl_new, Vc & fh_new, const double g, const double b, const double b_inv, const double t2_n, const double split, const double split_inv, Vc & err)
 	{
 		Vc fl = fl_prev, fh = fh_prev;
 
@@ -230,7 +230,7 @@ public:
 		fl_new = fl; fh_new = fh;
 	}
 
-	finline void carry(const Vc & fl_i, const Vc & fh_i, const double b, const double b_inv)
+	finline void carry(const Vc & fl_i, const Vc & fh_i, const double b, const double b_inv, const double split, const double split_inv)
 	{
 		Vc f = fl_i + fh_i * split;
 
@@ -268,6 +268,12 @@ private:
 	static const size_t n_io_s = n_io / 4 / 2;
 	static const size_t n_io_inv = N / n_io / VSIZE;
 	static const size_t n_gap = (VSIZE <= 4) ? 64 : 16 * VSIZE;	// Cache line size is 64 bytes. Alignment is needed if VSIZE > 4.
+	// |low part| <= split / 2: the error of its product grows with N, the split is reduced if n >= 20.
+	// The split is stored in the context if n >= 18: a context of another split is rejected.
+	// The context of n <= 17 has the layout of the previous releases.
+	static constexpr int split_log2 = (N <= (1 << 18)) ? 20 : (N <= (1 << 21)) ? 19 : 18;
+	static constexpr bool split_ctx = (N > (1 << 16));
+	static constexpr double split = double(1 << split_log2), split_inv = 1.0 / split;
 
 	finline static constexpr size_t index(const size_t k) { const size_t j = k / n_io, i = k % n_io; return j * (n_io + n_gap / sizeof(Complex)) + i; }
 
@@ -287,14 +293,26 @@ private:
 	static const size_t zrOffset = zhpOffset + zSize;
 
 	const size_t _num_threads;
-	const double _b, _b_inv;
+	double _b, _b_inv;
 	const size_t _mem_size, _cache_size;
 	bool _checkError;
 	double _error;
+	threadPool * _pool = nullptr;
 	char * const _mem;
+	size_t * const _reg;	// logical to physical registers
 	char * const _mem_copy;
+	std::vector<Vc *> _zp_slots;	// multiplicands #1, #2, ...
+	size_t _zp_index = 0;
 
 private:
+	// physical register #0 is at zlOffset and zhOffset, the others at zrOffset
+	finline size_t regOffset(const size_t r) const { const size_t p = _reg[r]; return (p == 0) ? zlOffset : zrOffset + (p - 1) * 2 * zSize; }
+	finline Vc * regl(const size_t r) const { return (Vc *)&_mem[regOffset(r)]; }
+	finline Vc * regh(const size_t r) const { return (Vc *)&_mem[regOffset(r) + zSize]; }
+	// multiplicand #0 is at zlpOffset and zhpOffset, the others are (zl, zh) blocks
+	finline Vc * zlp() const { return (_zp_index == 0) ? (Vc *)&_mem[zlpOffset] : _zp_slots[_zp_index - 1]; }
+	finline Vc * zhp() const { return (_zp_index == 0) ? (Vc *)&_mem[zhpOffset] : &_zp_slots[_zp_index - 1][zSize / sizeof(Vc)]; }
+
 	finline static void forward_out(Vc * const zl, Vc * const zh, const Complex * const w122i)
 	{
 		static const size_t stepi = index(n_io) / VSIZE;
@@ -344,8 +362,8 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		Vc * const zh = (Vc *)&_mem[zhOffset];
+		Vc * const zl = regl(0);
+		Vc * const zh = regh(0);
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -463,8 +481,8 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const zlp = (Vc *)&_mem[zlpOffset];
-		Vc * const zhp = (Vc *)&_mem[zhpOffset];
+		Vc * const zlp = this->zlp();
+		Vc * const zhp = this->zhp();
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -531,10 +549,10 @@ private:
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
 		const Vc * const ws = (Vc *)&_mem[wsOffset];
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		Vc * const zh = (Vc *)&_mem[zhOffset];
-		const Vc * const zlp = (Vc *)&_mem[zlpOffset];
-		const Vc * const zhp = (Vc *)&_mem[zhpOffset];
+		Vc * const zl = regl(0);
+		Vc * const zh = regh(0);
+		const Vc * const zlp = this->zlp();
+		const Vc * const zhp = this->zhp();
 
 		const size_t num_threads = _num_threads, s_io = N / n_io;
 		const size_t l_min = thread_id * s_io / num_threads, l_max = (thread_id + 1 == num_threads) ? s_io : (thread_id + 1) * s_io / num_threads;
@@ -646,8 +664,8 @@ private:
 	double pass2_0(const size_t thread_id, const bool dup)
 	{
 		const Complex * const w122i = (Complex *)&_mem[wOffset];
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		Vc * const zh = (Vc *)&_mem[zhOffset];
+		Vc * const zl = regl(0);
+		Vc * const zh = regh(0);
 		Vc * const fcl = (Vc *)&_mem[fclOffset]; Vc * const fl = &fcl[thread_id * n_io_inv];
 		Vc * const fch = (Vc *)&_mem[fchOffset]; Vc * const fh = &fch[thread_id * n_io_inv];
 		const double b = _b, b_inv = _b_inv, g = dup ? 2.0 : 1.0;
@@ -673,8 +691,8 @@ private:
 
 				const Vc fl_prev = (lh != l_min) ? fl[j] : Vc(0.0);
 				const Vc fh_prev = (lh != l_min) ? fh[j] : Vc(0.0);
-				if (!checkError) z8.mul_carry(fl_prev, fh_prev, fl[j], fh[j], g, b, b_inv, 2.0 / N);
-				else             z8.mul_carry(fl_prev, fh_prev, fl[j], fh[j], g, b, b_inv, 2.0 / N, err);
+				if (!checkError) z8.mul_carry(fl_prev, fh_prev, fl[j], fh[j], g, b, b_inv, 2.0 / N, split, split_inv);
+				else             z8.mul_carry(fl_prev, fh_prev, fl[j], fh[j], g, b, b_inv, 2.0 / N, split, split_inv, err);
 
 				if (lh != l_min) z8.transpose_out();
 				z8.store(zl_j, zh_j, index(n_io));	// transposed if lh = l_min
@@ -692,8 +710,8 @@ private:
 		const size_t thread_id_prev = ((thread_id != 0) ? thread_id : num_threads) - 1;
 		const size_t lh = thread_id * n_io_s / num_threads;	// l_min of pass2
 
-		Vc * const zl = (Vc *)&_mem[zlOffset]; Vc * const zl_l = &zl[2 * 4 / VSIZE * lh];
-		Vc * const zh = (Vc *)&_mem[zhOffset]; Vc * const zh_l = &zh[2 * 4 / VSIZE * lh];
+		Vc * const zl = regl(0); Vc * const zl_l = &zl[2 * 4 / VSIZE * lh];
+		Vc * const zh = regh(0); Vc * const zh_l = &zh[2 * 4 / VSIZE * lh];
 		const Vc * const fcl = (Vc *)&_mem[fclOffset]; const Vc * const fl = &fcl[thread_id_prev * n_io_inv];
 		const Vc * const fch = (Vc *)&_mem[fchOffset]; const Vc * const fh = &fch[thread_id_prev * n_io_inv];
 
@@ -711,7 +729,7 @@ private:
 				fl_prev.shift(fl[((j == 0) ? n_io_inv : j) - 1], j == 0);
 				fh_prev.shift(fh[((j == 0) ? n_io_inv : j) - 1], j == 0);
 			}
-			z8.carry(fl_prev, fh_prev, b, b_inv);
+			z8.carry(fl_prev, fh_prev, b, b_inv, split, split_inv);
 
 			z8.transpose_out();
 			z8.store(zl_j, zh_j, index(n_io));
@@ -728,8 +746,10 @@ public:
 		_b(b), _b_inv(1.0 / b),
 		_mem_size(wSize + wsSize + 2 * (zSize + fcSize + zSize + (num_regs - 1) * zSize) + 2 * 1024 * 1024),
 		_cache_size(wSize + wsSize + 2 * (zSize + fcSize)), _checkError(checkError), _error(0),
-		_mem((char *)alignNew(_mem_size, 2 * 1024 * 1024)), _mem_copy((char *)alignNew(2 * zSize, 1024))
+		_mem((char *)alignNew(_mem_size, 2 * 1024 * 1024)), _reg(new size_t[num_regs]), _mem_copy((char *)alignNew(2 * zSize, 1024))
 	{
+		for (size_t r = 0; r < num_regs; ++r) _reg[r] = r;
+
 		Complex * const w122i = (Complex *)&_mem[wOffset];
 		for (size_t s = N / 16; s >= 4; s /= 4)
 		{
@@ -755,18 +775,35 @@ public:
 
 	virtual ~transformCPUf64s()
 	{
+		delete _pool;
 		alignDelete((void *)_mem);
+		delete[] _reg;
 		alignDelete((void *)_mem_copy);
+		for (Vc * const zp : _zp_slots) alignDelete((void *)zp);
 	}
 
-	size_t getMemSize() const override { return _mem_size; }
+	size_t getMemSize() const override { return _mem_size + _zp_slots.size() * 2 * zSize; }
 	size_t getCacheSize() const override { return _cache_size; }
 
+	bool setBase(const uint32_t b, const bool checkError) override
+	{
+		setB(b);
+		_b = b; _b_inv = 1.0 / b;
+		_checkError = checkError; _error = 0;
+		return true;
+	}
+
+	void setThreadPool(const threadPool::EWait wait) override
+	{
+		delete _pool; _pool = nullptr;
+		if (_num_threads > 1) _pool = new threadPool(_num_threads, wait);
+	}
+
 protected:
 	void getZi(int32_t * const zi) const override
 	{
-		const Vc * const zl = (Vc *)&_mem[zlOffset];
-		const Vc * const zh = (Vc *)&_mem[zhOffset];
+		const Vc * const zl = regl(0);
+		const Vc * const zh = regh(0);
 
 		Vc * const zl_copy = (Vc *)&_mem_copy[0];
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zl_copy[k] = zl[k];
@@ -795,8 +832,8 @@ protected:
 
 	void setZi(const int32_t * const zi) override
 	{
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		Vc * const zh = (Vc *)&_mem[zhOffset];
+		Vc * const zl = regl(0);
+		Vc * const zh = regh(0);
 
 		for (size_t k = 0; k < N; k += VSIZE)
 		{
@@ -824,17 +861,19 @@ public:
 		int kind = 0;
 		if (!cFile.read(reinterpret_cast<char *>(&kind), sizeof(kind))) return false;
 		if (kind != static_cast<int>(getKind())) return false;
+		if (split_ctx)
+		{
+			int s_log2 = 0;
+			if (!cFile.read(reinterpret_cast<char *>(&s_log2), sizeof(s_log2))) return false;
+			if (s_log2 != split_log2) return false;
+		}
 
 		if (!cFile.read(reinterpret_cast<char *>(&_error), sizeof(_error))) return false;
 
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		if (!cFile.read(reinterpret_cast<char *>(zl), zSize)) return false;
-		Vc * const zh = (Vc *)&_mem[zhOffset];
-		if (!cFile.read(reinterpret_cast<char *>(zh), zSize)) return false;
-		if (num_regs > 1)
+		for (size_t r = 0, nr = std::max(num_regs, size_t(1)); r < nr; ++r)
 		{
-			Vc * const zr = (Vc *)&_mem[zrOffset];
-			if (!cFile.read(reinterpret_cast<char *>(zr), (num_regs - 1) * 2 * zSize)) return false;
+			if (!cFile.read(reinterpret_cast<char *>(regl(r)), zSize)) return false;
+			if (!cFile.read(reinterpret_cast<char *>(regh(r)), zSize)) return false;
 		}
 
 		return true;
@@ -844,24 +883,25 @@ public:
 	{
 		const int kind = static_cast<int>(getKind());
 		if (!cFile.write(reinterpret_cast<const char *>(&kind), sizeof(kind))) return;
+		if (split_ctx)
+		{
+			const int s_log2 = split_log2;
+			if (!cFile.write(reinterpret_cast<const char *>(&s_log2), sizeof(s_log2))) return;
+		}
 
 		if (!cFile.write(reinterpret_cast<const char *>(&_error), sizeof(_error))) return;
 
-		const Vc * const zl = (Vc *)&_mem[zlOffset];
-		if (!cFile.write(reinterpret_cast<const char *>(zl), zSize)) return;
-		const Vc * const zh = (Vc *)&_mem[zhOffset];
-		if (!cFile.write(reinterpret_cast<const char *>(zh), zSize)) return;
-		if (num_regs > 1)
+		for (size_t r = 0, nr = std::max(num_regs, size_t(1)); r < nr; ++r)
 		{
-			const Vc * const zr = (Vc *)&_mem[zrOffset];
-			if (!cFile.write(reinterpret_cast<const char *>(zr), (num_regs - 1) * 2 * zSize)) return;
+			if (!cFile.write(reinterpret_cast<const char *>(regl(r)), zSize)) return;
+			if (!cFile.write(reinterpret_cast<const char *>(regh(r)), zSize)) return;
 		}
 	}
 
 	void set(const int32_t a) override
 	{
-		Vc * const zl = (Vc *)&_mem[zlOffset];
-		Vc * const zh = (Vc *)&_mem[zhOffset];
+		Vc * const zl = regl(0);
+		Vc * const zh = regh(0);
 		zl[0] = Vc(a); zh[0] = Vc(0.0);
 		for (size_t k = 1; k < index(N) / VSIZE; ++k) { zl[k] = zh[k] = Vc(0.0); }
 
@@ -877,7 +917,20 @@ public:
 		const size_t num_threads = _num_threads;
 		double e[num_threads];
 
-		if (num_threads > 1)
+		if (_pool != nullptr)
+		{
+			threadPool & pool = *_pool;
+			double * const pe = e;
+			pool.run([&](const size_t thread_id)
+			{
+				pass1(thread_id);
+				pool.barrier(thread_id);
+				pe[thread_id] = pass2_0(thread_id, dup);
+				pool.barrier(thread_id);
+				pass2_1(thread_id);
+			});
+		}
+		else if (num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -904,14 +957,18 @@ public:
 
 	void initMultiplicand(const size_t src) override
 	{
-		const Vc * const zl_src = (Vc *)&_mem[(src == 0) ? zlOffset : zrOffset + (src - 1) * 2 * zSize];
-		const Vc * const zh_src = (Vc *)&_mem[(src == 0) ? zhOffset : zrOffset + (src - 1) * 2 * zSize + zSize];
-		Vc * const zlp = (Vc *)&_mem[zlpOffset];
+		const Vc * const zl_src = regl(src);
+		const Vc * const zh_src = regh(src);
+		Vc * const zlp = this->zlp();
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zlp[k] = zl_src[k];
-		Vc * const zhp = (Vc *)&_mem[zhpOffset];
+		Vc * const zhp = this->zhp();
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zhp[k] = zh_src[k];
 
-		if (_num_threads > 1)
+		if (_pool != nullptr)
+		{
+			_pool->run([&](const size_t thread_id) { pass1multiplicand(thread_id); });
+		}
+		else if (_num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -930,7 +987,20 @@ public:
 		const size_t num_threads = _num_threads;
 		double e[num_threads];
 
-		if (num_threads > 1)
+		if (_pool != nullptr)
+		{
+			threadPool & pool = *_pool;
+			double * const pe = e;
+			pool.run([&](const size_t thread_id)
+			{
+				pass1mul(thread_id);
+				pool.barrier(thread_id);
+				pe[thread_id] = pass2_0(thread_id, false);
+				pool.barrier(thread_id);
+				pass2_1(thread_id);
+			});
+		}
+		else if (num_threads > 1)
 		{
 #pragma omp parallel
 			{
@@ -957,17 +1027,36 @@ public:
 
 	void copy(const size_t dst, const size_t src) const override
 	{
-		const Vc * const zl_src = (Vc *)&_mem[(src == 0) ? zlOffset : zrOffset + (src - 1) * 2 * zSize];
-		const Vc * const zh_src = (Vc *)&_mem[(src == 0) ? zhOffset : zrOffset + (src - 1) * 2 * zSize + zSize];
+		const Vc * const zl_src = regl(src);
+		const Vc * const zh_src = regh(src);
 
-		Vc * const zl_dst = (Vc *)&_mem[(dst == 0) ? zlOffset : zrOffset + (dst - 1) * 2 * zSize];
-		Vc * const zh_dst = (Vc *)&_mem[(dst == 0) ? zhOffset : zrOffset + (dst - 1) * 2 * zSize + zSize];
+		Vc * const zl_dst = regl(dst);
+		Vc * const zh_dst = regh(dst);
 
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zl_dst[k] = zl_src[k];
 		for (size_t k = 0; k < index(N) / VSIZE; ++k) zh_dst[k] = zh_src[k];
 	}
 
+	void swap(const size_t r1, const size_t r2) override { std::swap(_reg[r1], _reg[r2]); }
+
+	bool selectMultiplicand(const size_t slot) override
+	{
+		if (slot > getMaxMultiplicands()) return false;
+		while (_zp_slots.size() < slot) _zp_slots.push_back((Vc *)alignNew(2 * zSize, 1024));
+		_zp_index = slot;
+		return true;
+	}
+
+	void setMaxMultiplicands(const size_t max_multiplicands) override
+	{
+		transform::setMaxMultiplicands(max_multiplicands);
+		while (_zp_slots.size() > max_multiplicands) { alignDelete((void *)_zp_slots.back()); _zp_slots.pop_back(); }
+		_zp_index = 0;
+	}
+
 	double getError() const override { return _error; }
+	void resetError() override { _error = 0; }
+	void setCheckError(const bool checkError) override { _checkError = checkError; }
 };
 
 template<size_t VSIZE>
@@ -983,9 +1072,7 @@ inline transform * create_transformCPUf64s(const uint32_t b, const uint32_t n, c
 	else if (n == 15) pTransform = new transformCPUf64s<(1 << 14), VSIZE>(b, n, num_threads, num_regs, checkError);
 	else if (n == 16) pTransform = new transformCPUf64s<(1 << 15), VSIZE>(b, n, num_threads, num_regs, checkError);
 	else if (n == 17) pTransform = new transformCPUf64s<(1 << 16), VSIZE>(b, n, num_threads, num_regs, checkError);
-#endif
-#if defined(SBDTRANSFORM)
-	if      (n == 18) pTransform = new transformCPUf64s<(1 << 17), VSIZE>(b, n, num_threads, num_regs, checkError);
+	else if (n == 18) pTransform = new transformCPUf64s<(1 << 17), VSIZE>(b, n, num_threads, num_regs, checkError);
 	else if (n == 19) pTransform = new transformCPUf64s<(1 << 18), VSIZE>(b, n, num_threads, num_regs, checkError);
 	else if (n == 20) pTransform = new transformCPUf64s<(1 << 19), VSIZE>(b, n, num_threads, num_regs, checkError);
 	else if (n == 21) pTransform = new transformCPUf64s<(1 << 20), VSIZE>(b, n, num_threads, num_regs, checkError);
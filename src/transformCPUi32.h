@@ -8,7 +8,9 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #pragma once
 
 #include <cstdint>
+#include <vector>
 #include <immintrin.h>
+#include <omp.h>
 
 #include "transform.h"
 
@@ -409,15 +411,24 @@ public:
 class transformCPUi32 : public transform
 {
 private:
+	const size_t _num_threads;
 	const size_t _mem_size, _cache_size;
 	const RNS4 _norm;
-	const uint32_t _b, _b_inv;
-	const int _b_s;
+	uint32_t _b, _b_inv;
+	int _b_s;
+	const size_t _s_mt;
 	RNS4 * const _z;
 	RNS4 * const _wr;
 	RNS4 * const _zp;
+	int64_4 * const _fc;	// the carries of the threads
+	size_t * const _reg;	// logical to physical registers
+	std::vector<RNS4 *> _zp_slots;	// multiplicands #1, #2, ...
+	size_t _zp_index = 0;
 
 private:
+	finline RNS4 * reg(const size_t r) const { return &_z[_reg[r] * (getSize() / 4)]; }
+	finline RNS4 * zp() const { return (_zp_index == 0) ? _zp : _zp_slots[_zp_index - 1]; }
+
 	finline static uint64_4 barrett(const uint64_4 a, const uint32_t b, const uint32_t b_inv, const int b_s, uint64_4 & a_p)
 	{
 		// n = 31, alpha = 2^{n-2} = 2^29, s = r - 2, t = n + 1 = 32 => h = 1.
@@ -497,14 +508,19 @@ private:
 	}
 
 public:
-	transformCPUi32(const uint32_t b, const uint32_t n, const size_t num_regs) : transform(size_t(1) << n, n, b, EKind::NTT3cpu),
-		_mem_size((size_t(1) << n) / 4 * (num_regs + 2) * sizeof(RNS4)), _cache_size((size_t(1) << n) / 4 * sizeof(RNS4)),
+	transformCPUi32(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs) : transform(size_t(1) << n, n, b, EKind::NTT3cpu),
+		_num_threads(num_threads), _mem_size((size_t(1) << n) / 4 * (num_regs + 2) * sizeof(RNS4)), _cache_size((size_t(1) << n) / 4 * sizeof(RNS4)),
 		_norm(Zp1::norm(static_cast<uint32_t>(1) << (n - 1)), Zp2::norm(static_cast<uint32_t>(1) << (n - 1)), Zp3::norm(static_cast<uint32_t>(1) << (n - 1))),
 		_b(b), _b_inv(static_cast<uint32_t>((static_cast<uint64_t>(1) << ((static_cast<int>(31 - __builtin_clz(b) - 1)) + 32)) / b)), _b_s(static_cast<int>(31 - __builtin_clz(b) - 1)),
+		_s_mt(s_mt(size_t(1) << n, num_threads)),
 		_z((RNS4 *)alignNew((size_t(1) << n) / 4 * num_regs * sizeof(RNS4), 1024)),
 		_wr((RNS4 *)alignNew(2 * (size_t(1) << n) / 4 * sizeof(RNS4), 1024)),
-		_zp((RNS4 *)alignNew((size_t(1) << n) / 4 * sizeof(RNS4), 1024))
+		_zp((RNS4 *)alignNew((size_t(1) << n) / 4 * sizeof(RNS4), 1024)),
+		_fc((int64_4 *)alignNew(num_threads * sizeof(int64_4), 64)),
+		_reg(new size_t[num_regs])
 	{
+		for (size_t r = 0; r < num_regs; ++r) _reg[r] = r;
+
 		const size_t size_4 = (size_t(1) << n) / 4;
 		RNS4 * const wr = _wr;
 		RNS4 * const wri = &wr[size_4];
@@ -538,12 +554,31 @@ public:
 		alignDelete((void *)_z);
 		alignDelete((void *)_wr);
 		alignDelete((void *)_zp);
+		alignDelete((void *)_fc);
+		delete[] _reg;
+		for (RNS4 * const zp : _zp_slots) alignDelete((void *)zp);
 	}
 
-	size_t getMemSize() const override { return _mem_size; }
+	size_t getMemSize() const override { return _mem_size + _zp_slots.size() * getSize() / 4 * sizeof(RNS4); }
 	size_t getCacheSize() const override { return _cache_size; }
 
+	bool setBase(const uint32_t b, const bool) override
+	{
+		setB(b);
+		_b = b; _b_s = static_cast<int>(31 - __builtin_clz(b) - 1);
+		_b_inv = static_cast<uint32_t>((static_cast<uint64_t>(1) << (_b_s + 32)) / b);
+		return true;
+	}
+
 private:
+	// Number of sub-transforms processed by the threads: the first log4(s_mt) levels of the recursion are split over the threads.
+	static size_t s_mt(const size_t size, const size_t num_threads)
+	{
+		size_t s = 1;
+		if (num_threads > 1) while ((s < 4 * num_threads) && (size / 16 / s >= 16)) s *= 4;
+		return s;
+	}
+
 	finline static void forward_2(RNS4 * const z, const size_t k, const size_t m, const RNS4 & w1)
 	{
 		RNS4 & z0 = z[k + 0 * m]; RNS4 & z1 = z[k + 1 * m]; RNS4 & z2 = z[k + 2 * m]; RNS4 & z3 = z[k + 3 * m];
@@ -638,6 +673,27 @@ private:
 		for (size_t i = 0; i < m; ++i) backward_4(z, 4 * m * j + i, m, wi1, wi2, wi3);
 	}
 
+	// forward4 / backward4 of level s_4 (sr_4 = 1, jr = 0) restricted to the butterflies [t_min, t_max)
+	finline static void forward4(RNS4 * const z, const RNS4 * const wr, const size_t m, const size_t s_4, const size_t t_min, const size_t t_max)
+	{
+		for (size_t j = t_min / m; j * m < t_max; ++j)
+		{
+			const RNS4 w1 = wr[s_4 + j], w2 = wr[2 * (s_4 + j) + 0], w3 = wr[2 * (s_4 + j) + 1];
+			const size_t i_min = std::max(t_min, j * m) - j * m, i_max = std::min(t_max, (j + 1) * m) - j * m;
+			for (size_t i = i_min; i < i_max; ++i) forward_4(z, 4 * m * j + i, m, w1, w2, w3);
+		}
+	}
+
+	finline static void backward4(RNS4 * const z, const RNS4 * const wri, const size_t m, const size_t s_4, const size_t t_min, const size_t t_max)
+	{
+		for (size_t j = t_min / m; j * m < t_max; ++j)
+		{
+			const RNS4 wi1 = wri[s_4 + j], wi2 = wri[2 * (s_4 + j) + 0], wi3 = wri[2 * (s_4 + j) + 1];
+			const size_t i_min = std::max(t_min, j * m) - j * m, i_max = std::min(t_max, (j + 1) * m) - j * m;
+			for (size_t i = i_min; i < i_max; ++i) backward_4(z, 4 * m * j + i, m, wi1, wi2, wi3);
+		}
+	}
+
 	finline static void forward2(RNS4 * const z, const RNS4 * const wr, const size_t m, const size_t s_4, const size_t j0)
 	{
 		for (size_t i = 0, j = j0; i < m; ++i, ++j) forward_2(z, 4 * j, 1, wr[s_4 + j]);
@@ -765,12 +821,146 @@ private:
 		}
 	}
 
+	// Block-parallel carry propagation: each thread normalizes z[k_min:k_max] and returns its carry
+	int64_4 baseMod_block(RNS4 * const z, const size_t k_min, const size_t k_max, const bool dup) const
+	{
+		const RNS4 norm = _norm;
+		const uint32_t b = _b, b_inv = _b_inv;
+		const int b_s = _b_s;
+
+		int96_4 f96 = int96_4(0);
+
+		for (size_t k = k_min; k < k_max; ++k)
+		{
+			int96_4 l = garner3(z[k] * norm);
+			if (dup) l += l;
+			f96 += l;
+			z[k] = reduce96(f96, b, b_inv, b_s);
+		}
+
+		return f96.get64();
+	}
+
+	// Add the carry f to z[k_min:k_max], f is the remaining carry
+	void carry_block(RNS4 * const z, const size_t k_min, const size_t k_max, int64_4 & f) const
+	{
+		const uint32_t b = _b, b_inv = _b_inv;
+		const int b_s = _b_s;
+
+		for (size_t k = k_min; k < k_max; ++k)
+		{
+			if (f.isZero()) return;
+			f += int64_4(z[k].r1().getInt());
+			z[k] = reduce64(f, b, b_inv, b_s);
+		}
+	}
+
+	void baseMod_mt(const size_t thread_id, RNS4 * const z, int64_4 * const fc, const bool dup)
+	{
+		const size_t num_threads = _num_threads, size_4 = getSize() / 4;
+		const size_t k_min = thread_id * size_4 / num_threads, k_max = (thread_id + 1) * size_4 / num_threads;
+
+		backward0(&z[k_min], k_max - k_min);
+		fc[thread_id] = baseMod_block(z, k_min, k_max, dup);
+#pragma omp barrier
+		int64_4 f = fc[(thread_id != 0) ? thread_id - 1 : num_threads - 1];
+		if (thread_id == 0) f.rotate();	// a_0 = -a_n
+#pragma omp barrier
+		carry_block(z, k_min, k_max, f);
+		fc[thread_id] = f;
+	}
+
+	// The carries are rarely propagated beyond the next block
+	void carry_mt(RNS4 * const z, int64_4 * const fc) const
+	{
+		const size_t num_threads = _num_threads, size_4 = getSize() / 4;
+
+		for (size_t i = 0; i < num_threads; ++i)
+		{
+			int64_4 f = fc[i];
+			size_t k = (i + 1) * size_4 / num_threads;
+			while (!f.isZero())
+			{
+				if (k == size_4) { f.rotate(); k = 0; }
+				carry_block(z, k, k + 1, f);
+				++k;
+			}
+		}
+	}
+
+	void forward_mt(const size_t thread_id, RNS4 * const z)
+	{
+		const size_t num_threads = _num_threads, size_4 = getSize() / 4, mr = size_4 / 4, s_mt = _s_mt;
+		const RNS4 * const wr = _wr;
+
+		const size_t k_min = thread_id * size_4 / num_threads, k_max = (thread_id + 1) * size_4 / num_threads;
+		forward0(&z[k_min], k_max - k_min);
+
+		const size_t t_min = thread_id * mr / num_threads, t_max = (thread_id + 1) * mr / num_threads;
+		for (size_t s = 1; s < s_mt; s *= 4)
+		{
+#pragma omp barrier
+			forward4(z, wr, mr / s, s, t_min, t_max);
+		}
+#pragma omp barrier
+	}
+
+	void backward_mt(const size_t thread_id, RNS4 * const z)
+	{
+		const size_t num_threads = _num_threads, mr = getSize() / 16, s_mt = _s_mt;
+		const RNS4 * const wri = &_wr[getSize() / 4];
+
+		const size_t t_min = thread_id * mr / num_threads, t_max = (thread_id + 1) * mr / num_threads;
+		for (size_t s = s_mt / 4; s >= 1; s /= 4)
+		{
+#pragma omp barrier
+			backward4(z, wri, mr / s, s, t_min, t_max);
+		}
+#pragma omp barrier
+	}
+
+	void square_mt(const size_t thread_id, int64_4 * const fc, const bool dup)
+	{
+		const size_t num_threads = _num_threads, mr = getSize() / 16, s_mt = _s_mt;
+		const RNS4 * const wr = _wr;
+		RNS4 * const z = reg(0);
+
+		forward_mt(thread_id, z);
+		const size_t j_min = thread_id * s_mt / num_threads, j_max = (thread_id + 1) * s_mt / num_threads;
+		for (size_t j = j_min; j < j_max; ++j) square(z, wr, &wr[getSize() / 4], mr / s_mt, s_mt, j);
+		backward_mt(thread_id, z);
+		baseMod_mt(thread_id, z, fc, dup);
+	}
+
+	void mul_mt(const size_t thread_id, int64_4 * const fc)
+	{
+		const size_t num_threads = _num_threads, mr = getSize() / 16, s_mt = _s_mt;
+		const RNS4 * const wr = _wr;
+		RNS4 * const z = reg(0);
+
+		forward_mt(thread_id, z);
+		const size_t j_min = thread_id * s_mt / num_threads, j_max = (thread_id + 1) * s_mt / num_threads;
+		for (size_t j = j_min; j < j_max; ++j) mul(z, zp(), wr, &wr[getSize() / 4], mr / s_mt, s_mt, j);
+		backward_mt(thread_id, z);
+		baseMod_mt(thread_id, z, fc, false);
+	}
+
+	void multiplicand_mt(const size_t thread_id)
+	{
+		const size_t num_threads = _num_threads, mr = getSize() / 16, s_mt = _s_mt;
+		RNS4 * const zp = this->zp();
+
+		forward_mt(thread_id, zp);
+		const size_t j_min = thread_id * s_mt / num_threads, j_max = (thread_id + 1) * s_mt / num_threads;
+		for (size_t j = j_min; j < j_max; ++j) forward(zp, _wr, mr / s_mt, s_mt, j);
+	}
+
 protected:
 	void getZi(int32_t * const zi) const override
 	{
 		const size_t size_4 = getSize() / 4;
 
-		RNS4 * const z = _z;
+		RNS4 * const z = reg(0);
 		for (size_t k = 0; k < size_4; ++k)
 		{
 			const Zp4_1 r1 = z[k].r1();
@@ -782,7 +972,7 @@ protected:
 	{
 		const size_t size_4 = getSize() / 4;
 
-		RNS4 * const z = _z;
+		RNS4 * const z = reg(0);
 		for (size_t k = 0; k < size_4; ++k)
 		{
 			int32_t zik[4]; for (size_t i = 0; i < 4; ++i) zik[i] = zi[i * size_4 + k];
@@ -801,7 +991,10 @@ public:
 		if (kind != static_cast<int>(getKind())) return false;
 
 		const size_t size_4 = getSize() / 4;
-		if (!cFile.read(reinterpret_cast<char *>(_z), sizeof(RNS4) * size_4 * num_regs)) return false;
+		for (size_t r = 0; r < num_regs; ++r)
+		{
+			if (!cFile.read(reinterpret_cast<char *>(reg(r)), sizeof(RNS4) * size_4)) return false;
+		}
 		return true;
 	}
 
@@ -811,23 +1004,39 @@ public:
 		if (!cFile.write(reinterpret_cast<const char *>(&kind), sizeof(kind))) return;
 
 		const size_t size_4 = getSize() / 4;
-		if (!cFile.write(reinterpret_cast<const char *>(_z), sizeof(RNS4) * size_4 * num_regs)) return;
+		for (size_t r = 0; r < num_regs; ++r)
+		{
+			if (!cFile.write(reinterpret_cast<const char *>(reg(r)), sizeof(RNS4) * size_4)) return;
+		}
 	}
 
 	void set(const int32_t a) override
 	{
 		const size_t size_4 = getSize() / 4;
 
-		RNS4 * const z = _z;
+		RNS4 * const z = reg(0);
 		z[0] = RNS4(Zp4_1(Zp1(a), Zp1(0), Zp1(0), Zp1(0)), Zp4_2(Zp2(a), Zp2(0), Zp2(0), Zp2(0)), Zp4_3(Zp3(a), Zp3(0), Zp3(0), Zp3(0)));
 		for (size_t k = 1; k < size_4; ++k) z[k] = RNS4(Zp1(0), Zp2(0), Zp3(0));
 	}
 
 	void squareDup(const bool dup) override
 	{
+		const size_t num_threads = _num_threads;
+		if (num_threads > 1)
+		{
+			int64_4 * const fc = _fc;
+#pragma omp parallel
+			{
+				const size_t thread_id = size_t(omp_get_thread_num());
+				square_mt(thread_id, fc, dup);
+			}
+			carry_mt(reg(0), fc);
+			return;
+		}
+
 		const size_t size_4 = getSize() / 4;
 		const RNS4 * const wr = _wr;
-		RNS4 * const z = _z;
+		RNS4 * const z = reg(0);
 
 		forward0(z, size_4);
 		square(z, wr, &wr[size_4], size_4 / 4, 1, 0);
@@ -839,10 +1048,20 @@ public:
 	void initMultiplicand(const size_t src) override
 	{
 		const size_t size_4 = getSize() / 4;
-		const RNS4 * const z = _z;
-		RNS4 * const zp = _zp;
+		const RNS4 * const z = reg(src);
+		RNS4 * const zp = this->zp();
 
-		for (size_t k = 0; k < size_4; ++k) zp[k] = z[k + src * size_4];
+		for (size_t k = 0; k < size_4; ++k) zp[k] = z[k];
+
+		if (_num_threads > 1)
+		{
+#pragma omp parallel
+			{
+				const size_t thread_id = size_t(omp_get_thread_num());
+				multiplicand_mt(thread_id);
+			}
+			return;
+		}
 
 		forward0(zp, size_4);
 		forward(zp, _wr, size_4 / 4, 1, 0);
@@ -850,12 +1069,25 @@ public:
 
 	void mul() override
 	{
+		const size_t num_threads = _num_threads;
+		if (num_threads > 1)
+		{
+			int64_4 * const fc = _fc;
+#pragma omp parallel
+			{
+				const size_t thread_id = size_t(omp_get_thread_num());
+				mul_mt(thread_id, fc);
+			}
+			carry_mt(reg(0), fc);
+			return;
+		}
+
 		const size_t size_4 = getSize() / 4;
 		const RNS4 * const wr = _wr;
-		RNS4 * const z = _z;
+		RNS4 * const z = reg(0);
 
 		forward0(z, size_4);
-		mul(z, _zp, wr, &wr[size_4], size_4 / 4, 1, 0);
+		mul(z, zp(), wr, &wr[size_4], size_4 / 4, 1, 0);
 		backward0(z, size_4);
 
 		baseMod(size_4, z);
@@ -864,8 +1096,26 @@ public:
 	void copy(const size_t dst, const size_t src) const override
 	{
 		const size_t size_4 = getSize() / 4;
-		RNS4 * const z = _z;
+		const RNS4 * const z_src = reg(src);
+		RNS4 * const z_dst = reg(dst);
+
+		for (size_t k = 0; k < size_4; ++k) z_dst[k] = z_src[k];
+	}
 
-		for (size_t k = 0; k < size_4; ++k) z[k + dst * size_4] = z[k + src * size_4];
+	void swap(const size_t r1, const size_t r2) override { std::swap(_reg[r1], _reg[r2]); }
+
+	bool selectMultiplicand(const size_t slot) override
+	{
+		if (slot > getMaxMultiplicands()) return false;
+		while (_zp_slots.size() < slot) _zp_slots.push_back((RNS4 *)alignNew(getSize() / 4 * sizeof(RNS4), 1024));
+		_zp_index = slot;
+		return true;
+	}
+
+	void setMaxMultiplicands(const size_t max_multiplicands) override
+	{
+		transform::setMaxMultiplicands(max_multiplicands);
+		while (_zp_slots.size() > max_multiplicands) { alignDelete((void *)_zp_slots.back()); _zp_slots.pop_back(); }
+		_zp_index = 0;
 	}
 };
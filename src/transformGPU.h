@@ -142,6 +142,10 @@ private:
 	cl_mem _z = nullptr, _zp = nullptr, _w = nullptr;
 	cl_mem _ze = nullptr, _zpe = nullptr, _we = nullptr;
 	cl_mem _c = nullptr;
+	std::vector<cl_mem> _zr, _zre;	// the registers are sub-buffers of _z and _ze
+	size_t _reg0 = 0;				// the register of the transform, square, mul and normalize kernels
+	std::vector<cl_mem> _zpr, _zpre;	// the multiplicands are sub-buffers of _zp and _zpe
+	size_t _regp = 0;				// the multiplicand of the fwd*p, mul and copyp kernels
 	cl_kernel _forward64 = nullptr, _backward64 = nullptr, _forward256 = nullptr, _backward256 = nullptr, _forward1024 = nullptr, _backward1024 = nullptr;
 	cl_kernel _square32 = nullptr, _square64 = nullptr, _square128 = nullptr, _square256 = nullptr, _square512 = nullptr, _square1024 = nullptr, _square2048 = nullptr;
 	cl_kernel _normalize1 = nullptr, _normalize2 = nullptr;
@@ -212,16 +216,46 @@ public:
 		if (n != 0)
 		{
 			_z = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNS) * n * num_regs);
-			_zp = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNS) * n);
 			_w = _createBuffer(CL_MEM_READ_ONLY, sizeof(RNS_W) * 2 * n);
 			if (RNS_SIZE == 3)
 			{
 				_ze = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNSe) * n * num_regs);
-				_zpe = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNSe) * n);
 				_we = _createBuffer(CL_MEM_READ_ONLY, sizeof(RNS_We) * 2 * n);
 			}
 			_c = _createBuffer(CL_MEM_READ_WRITE, sizeof(cl_long) * n / 4);
+
+			for (size_t r = 0; r < num_regs; ++r)
+			{
+				_zr.push_back(_createSubBuffer(_z, CL_MEM_READ_WRITE, sizeof(RNS) * n * r, sizeof(RNS) * n));
+				if (RNS_SIZE == 3) _zre.push_back(_createSubBuffer(_ze, CL_MEM_READ_WRITE, sizeof(RNSe) * n * r, sizeof(RNSe) * n));
+			}
+			_reg0 = 0;
+
+			allocMultiplicands(1);
+		}
+	}
+
+	void allocMultiplicands(const size_t count)
+	{
+		const size_t n = _n;
+		_zp = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNS) * n * count);
+		if (RNS_SIZE == 3) _zpe = _createBuffer(CL_MEM_READ_WRITE, sizeof(RNSe) * n * count);
+
+		for (size_t m = 0; m < count; ++m)
+		{
+			_zpr.push_back(_createSubBuffer(_zp, CL_MEM_READ_WRITE, sizeof(RNS) * n * m, sizeof(RNS) * n));
+			if (RNS_SIZE == 3) _zpre.push_back(_createSubBuffer(_zpe, CL_MEM_READ_WRITE, sizeof(RNSe) * n * m, sizeof(RNSe) * n));
 		}
+		_regp = 0;
+	}
+
+	void releaseMultiplicands()
+	{
+		for (cl_mem & zpr : _zpr) _releaseBuffer(zpr);
+		for (cl_mem & zpre : _zpre) _releaseBuffer(zpre);
+		_zpr.clear(); _zpre.clear();
+		_releaseBuffer(_zp);
+		if (RNS_SIZE == 3) _releaseBuffer(_zpe);
 	}
 
 	void releaseMemory()
@@ -232,13 +266,15 @@ public:
 #endif
 		if (_n != 0)
 		{
+			for (cl_mem & zr : _zr) _releaseBuffer(zr);
+			for (cl_mem & zre : _zre) _releaseBuffer(zre);
+			_zr.clear(); _zre.clear();
+			releaseMultiplicands();
 			_releaseBuffer(_z);
-			_releaseBuffer(_zp); 
 			_releaseBuffer(_w);  
 			if (RNS_SIZE == 3)
 			{
 				_releaseBuffer(_ze);
-				_releaseBuffer(_zpe);
 				_releaseBuffer(_we);
 			}
 			_releaseBuffer(_c);
@@ -252,8 +288,8 @@ private:
 	{
 		cl_kernel kernel = _createKernel(kernelName);
 		cl_uint index = 0;
-		_setKernelArg(kernel, index++, sizeof(cl_mem), isMultiplier ? &_z : &_zp);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), isMultiplier ? &_ze : &_zpe);
+		_setKernelArg(kernel, index++, sizeof(cl_mem), isMultiplier ? &_zr[_reg0] : &_zpr[_regp]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), isMultiplier ? &_zre[_reg0] : &_zpre[_regp]);
 		_setKernelArg(kernel, index++, sizeof(cl_mem), &_w);
 		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_we);
 		return kernel;
@@ -263,8 +299,8 @@ private:
 	{
 		cl_kernel kernel = _createKernel(kernelName);
 		cl_uint index = 0;
-		_setKernelArg(kernel, index++, sizeof(cl_mem), &_z);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_ze);
+		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zr[_reg0]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zre[_reg0]);
 		_setKernelArg(kernel, index++, sizeof(cl_mem), &_c);
 		_setKernelArg(kernel, index++, sizeof(cl_uint), &b);
 		_setKernelArg(kernel, index++, sizeof(cl_uint), &b_inv);
@@ -276,10 +312,10 @@ private:
 	{
 		cl_kernel kernel = _createKernel(kernelName);
 		cl_uint index = 0;
-		_setKernelArg(kernel, index++, sizeof(cl_mem), &_z);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_ze);
-		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zp);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zpe);
+		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zr[_reg0]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zre[_reg0]);
+		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zpr[_regp]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zpre[_regp]);
 		_setKernelArg(kernel, index++, sizeof(cl_mem), &_w);
 		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_we);
 		return kernel;
@@ -298,8 +334,8 @@ private:
 	{
 		cl_kernel kernel = _createKernel(kernelName);
 		cl_uint index = 0;
-		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zp);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zpe);
+		_setKernelArg(kernel, index++, sizeof(cl_mem), &_zpr[_regp]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_zpre[_regp]);
 		_setKernelArg(kernel, index++, sizeof(cl_mem), &_z);
 		if (RNS_SIZE == 3) _setKernelArg(kernel, index++, sizeof(cl_mem), &_ze);
 		return kernel;
@@ -377,11 +413,12 @@ public:
 
 ///////////////////////////////
 
-	void readMemory_z(RNS * const zPtr, const size_t count = 1) { _readBuffer(_z, zPtr, sizeof(RNS) * _n * count); }
-	void readMemory_ze(RNSe  * const zPtre, const size_t count = 1) { _readBuffer(_ze, zPtre, sizeof(RNSe) * _n * count); }
+	// count registers from register reg
+	void readMemory_z(RNS * const zPtr, const size_t count = 1, const size_t reg = 0) { _readBuffer(_z, zPtr, sizeof(RNS) * _n * count, sizeof(RNS) * _n * reg); }
+	void readMemory_ze(RNSe  * const zPtre, const size_t count = 1, const size_t reg = 0) { _readBuffer(_ze, zPtre, sizeof(RNSe) * _n * count, sizeof(RNSe) * _n * reg); }
 
-	void writeMemory_z(const RNS * const zPtr, const size_t count = 1) { _writeBuffer(_z, zPtr, sizeof(RNS) * _n * count); }
-	void writeMemory_ze(const RNSe * const zPtre, const size_t count = 1) { _writeBuffer(_ze, zPtre, sizeof(RNSe) * _n * count); }
+	void writeMemory_z(const RNS * const zPtr, const size_t count = 1, const size_t reg = 0) { _writeBuffer(_z, zPtr, sizeof(RNS) * _n * count, sizeof(RNS) * _n * reg); }
+	void writeMemory_ze(const RNSe * const zPtre, const size_t count = 1, const size_t reg = 0) { _writeBuffer(_ze, zPtre, sizeof(RNSe) * _n * count, sizeof(RNSe) * _n * reg); }
 
 	void writeMemory_w(const RNS_W * const wPtr) { _writeBuffer(_w, wPtr, sizeof(RNS_W) * 2 * _n); }
 	void writeMemory_we(const RNS_We * const wPtre) { _writeBuffer(_we, wPtre, sizeof(RNS_We) * 2 * _n); }
@@ -433,8 +470,22 @@ private:
 
 	void setTransformArgs(cl_kernel & kernel, const bool isMultiplier = true)
 	{
-		_setKernelArg(kernel, 0, sizeof(cl_mem), isMultiplier ? &_z : &_zp);
-		if (RNS_SIZE == 3) _setKernelArg(kernel, 1, sizeof(cl_mem), isMultiplier ? &_ze : &_zpe);
+		_setKernelArg(kernel, 0, sizeof(cl_mem), isMultiplier ? &_zr[_reg0] : &_zpr[_regp]);
+		if (RNS_SIZE == 3) _setKernelArg(kernel, 1, sizeof(cl_mem), isMultiplier ? &_zre[_reg0] : &_zpre[_regp]);
+	}
+
+	void setMultiplicandArgs()
+	{
+		for (cl_kernel * const kernel : { &_fwd32p, &_fwd64p, &_fwd128p, &_fwd256p, &_fwd512p, &_fwd1024p, &_fwd2048p, &_copyp })
+		{
+			setTransformArgs(*kernel, false);
+		}
+		const cl_uint index = (RNS_SIZE == 3) ? 2 : 1;
+		for (cl_kernel * const kernel : { &_mul32, &_mul64, &_mul128, &_mul256, &_mul512, &_mul1024, &_mul2048 })
+		{
+			_setKernelArg(*kernel, index, sizeof(cl_mem), &_zpr[_regp]);
+			if (RNS_SIZE == 3) _setKernelArg(*kernel, index + 1, sizeof(cl_mem), &_zpre[_regp]);
+		}
 	}
 
 	void forward64p(const int lm)
@@ -459,6 +510,37 @@ private:
 	}
 
 public:
+	// The kernels address the register reg: the registers are renamed without any copy
+	void setReg0(const size_t reg)
+	{
+		if (reg == _reg0) return;
+		_reg0 = reg;
+		for (cl_kernel * const kernel : { &_forward64, &_backward64, &_forward256, &_backward256, &_forward1024, &_backward1024,
+										  &_square32, &_square64, &_square128, &_square256, &_square512, &_square1024, &_square2048,
+										  &_normalize1, &_normalize2,
+										  &_mul32, &_mul64, &_mul128, &_mul256, &_mul512, &_mul1024, &_mul2048 })
+		{
+			setTransformArgs(*kernel);
+		}
+	}
+
+	// count multiplicands are allocated on the device, their values are lost
+	void setMultiplicands(const size_t count)
+	{
+		if (count == _zpr.size()) return;
+		releaseMultiplicands();
+		allocMultiplicands(count);
+		setMultiplicandArgs();
+	}
+
+	// The fwd*p, mul and copyp kernels address the multiplicand m
+	void setRegp(const size_t m)
+	{
+		if (m == _regp) return;
+		_regp = m;
+		setMultiplicandArgs();
+	}
+
 	void square()
 	{
 		const splitter * const pSplit = _pSplit;
@@ -737,9 +819,69 @@ private:
 		}
 	}
 
+private:
+	// baseModBlk digits of b are converted into a 32-bit value: the carry must fit in a block
+	bool validBaseModBlk(const uint32_t base, const size_t b) const
+	{
+		const double maxSqr = _n * (base * static_cast<double>(base));
+		if (log(maxSqr) >= base * log(static_cast<double>(b))) return false;
+		return (b >= 4) && (b <= 64) && (b >= log(_n * static_cast<double>(base + 2)) / log(static_cast<double>(base)));
+	}
+
+	static std::string tuneCacheFilename() { return pio::cachePath("genefer_gpu.tune"); }
+
+	// The lines of the cache file are 'device;driver;ln;RNS size;baseModBlk;naLocalWS;nbLocalWS;splitIndex'
+	std::string tuneKey() const
+	{
+		std::ostringstream ss; ss << getName() << ";" << getDriverVersion() << ";" << _ln << ";" << RNS_SIZE << ";";
+		return ss.str();
+	}
+
+	bool readTuneCache(const uint32_t base)
+	{
+		std::ifstream cacheFile(tuneCacheFilename());
+		const std::string key = tuneKey();
+		std::string line;
+		while (std::getline(cacheFile, line))
+		{
+			if (line.compare(0, key.size(), key) != 0) continue;
+			std::istringstream ss(line.substr(key.size()));
+			size_t b = 0, sa = 0, sb = 0, si = 0; char c1, c2, c3;
+			if (!(ss >> b >> c1 >> sa >> c2 >> sb >> c3 >> si)) return false;
+			if (!validBaseModBlk(base, b) || (sa > 256) || (sb > 256) || (si >= _pSplit->getSize())) return false;
+			_baseModBlk = b; _naLocalWS = sa; _nbLocalWS = sb; _splitIndex = si;
+			return true;
+		}
+		return false;
+	}
+
+	void saveTuneCache() const
+	{
+		const std::string key = tuneKey();
+		std::vector<std::string> lines;
+		{
+			std::ifstream cacheFile(tuneCacheFilename());
+			std::string line;
+			while (std::getline(cacheFile, line)) if (!line.empty() && (line.compare(0, key.size(), key) != 0)) lines.push_back(line);
+		}
+
+		// written and renamed: the cache is shared by the tasks of the project directory
+		const std::string cacheFilename = tuneCacheFilename(), tmpFilename = cacheFilename + ".tmp";
+		{
+			std::ofstream cacheFile(tmpFilename);
+			for (const std::string & line : lines) cacheFile << line << std::endl;
+			cacheFile << key << _baseModBlk << ";" << _naLocalWS << ";" << _nbLocalWS << ";" << _splitIndex << std::endl;
+			if (!cacheFile) return;
+		}
+		std::remove(cacheFilename.c_str());
+		std::rename(tmpFilename.c_str(), cacheFilename.c_str());
+	}
+
 public:
 	void tune(const uint32_t base)
 	{
+		if (readTuneCache(base)) return;
+
 		const size_t n = _n;
 
 		RNS * const Z = new RNS[n];
@@ -761,13 +903,9 @@ public:
 
 		cl_ulong minT = cl_ulong(-1);
 
-		size_t bMin = 4;
-		while (bMin < log(n * static_cast<double>(base + 2)) / log(static_cast<double>(base))) bMin *= 2;
-
-		for (size_t b = bMin; b <= 64; b *= 2)
+		for (size_t b = 4; b <= 64; b *= 2)
 		{
-			// Check convergence
-			if (log(maxSqr) >= base * log(static_cast<double>(b))) continue;
+			if (!validBaseModBlk(base, b)) continue;
 
 			resetProfiles();
 			baseModTune(count, b, 0, 0, Z, Ze);
@@ -850,6 +988,7 @@ public:
 		if (RNS_SIZE == 3) delete[] Ze;
 
 		setProfiling(false);
+		saveTuneCache();
 	}
 };
 
@@ -866,6 +1005,7 @@ private:
 	const size_t _num_regs;
 	RNS * const _z;
 	RNSe * const _ze;
+	size_t * const _reg;	// logical to physical registers
 	engine<RNS, RNSe, RNS_W, RNS_We, RNS_SIZE> * _pEngine = nullptr;
 
 public:
@@ -873,9 +1013,11 @@ public:
 				 const cl_platform_id boinc_platform_id, const cl_device_id boinc_device_id, const bool verbose)
 		: transform(size_t(1) << n, n, b, (RNS_SIZE == 3) ? EKind::NTT3 : EKind::NTT2),
 		_mem_size((size_t(1) << n) * num_regs * (sizeof(RNS) + ((RNS_SIZE == 3) ? sizeof(RNSe) : 0))), _num_regs(num_regs),
-		_z(new RNS[(size_t(1) << n) * num_regs]), _ze((RNS_SIZE == 3) ? new RNSe[(size_t(1) << n) * num_regs] : nullptr)
+		_z(new RNS[(size_t(1) << n) * num_regs]), _ze((RNS_SIZE == 3) ? new RNSe[(size_t(1) << n) * num_regs] : nullptr),
+		_reg(new size_t[num_regs])
 	{
 		const size_t size = getSize();
+		for (size_t r = 0; r < num_regs; ++r) _reg[r] = r;
 
 		const bool is_boinc_platform = isBoinc && (boinc_device_id != 0) && (boinc_platform_id != 0);
 		const platform eng_platform = is_boinc_platform ? platform(boinc_platform_id, boinc_device_id) : platform();
@@ -931,6 +1073,7 @@ public:
 		_pEngine->loadProgram(src.str());
 		_pEngine->allocMemory(num_regs);
 		_pEngine->createKernels(b);
+		_pEngine->setMultiplicands(getMaxMultiplicands() + 1);
 
 		RNS_W * const wr = new RNS_W[2 * size];
 		RNS_W * const wri = &wr[size];
@@ -997,15 +1140,24 @@ public:
 
 		delete[] _z;
 		if (RNS_SIZE == 3) delete[] _ze;
+		delete[] _reg;
 	}
 
-	size_t getMemSize() const override { return _mem_size; }
+	size_t getMemSize() const override { return _mem_size / _num_regs * (_num_regs + getMaxMultiplicands()); }
 	size_t getCacheSize() const override { return 0; }
 
+	// The registers are a single buffer, at most half of the memory of the device is used, the multiplicands included
+	size_t getMaxRegs() const override
+	{
+		const size_t reg_size = _mem_size / _num_regs, z_size = getSize() * sizeof(RNS);
+		const size_t max_regs = _pEngine->getGlobalMemSize() / 2 / reg_size, mul_regs = getMaxMultiplicands();
+		return std::min(_pEngine->getMaxMemAllocSize() / z_size, (max_regs > mul_regs) ? max_regs - mul_regs : 0);
+	}
+
 protected:
 	void getZi(int32_t * const zi) const override
 	{
-		_pEngine->readMemory_z(_z);
+		_pEngine->readMemory_z(_z, 1, _reg[0]);
 
 		const size_t size = getSize();
 
@@ -1019,13 +1171,13 @@ protected:
 
 		RNS * const z = _z;
 		for (size_t i = 0; i < size; ++i) z[i] = RNS(zi[i]);
-		_pEngine->writeMemory_z(z);
+		_pEngine->writeMemory_z(z, 1, _reg[0]);
 
 		if (RNS_SIZE == 3)
 		{
 			RNSe * const ze = _ze;
 			for (size_t i = 0; i < size; ++i) ze[i] = RNSe(zi[i]);
-			_pEngine->writeMemory_ze(_ze);
+			_pEngine->writeMemory_ze(_ze, 1, _reg[0]);
 		}
 	}
 
@@ -1039,12 +1191,12 @@ public:
 		const size_t size = getSize(), num_regs = (nregs != 0) ? nregs : _num_regs;
 
 		if (!cFile.read(reinterpret_cast<char *>(_z), sizeof(RNS) * size * num_regs)) return false;
-		_pEngine->writeMemory_z(_z, num_regs);
+		for (size_t r = 0; r < num_regs; ++r) _pEngine->writeMemory_z(&_z[r * size], 1, _reg[r]);
 
 		if (RNS_SIZE == 3)
 		{
 			if (!cFile.read(reinterpret_cast<char *>(_ze), sizeof(RNSe) * size * num_regs)) return false;
-			_pEngine->writeMemory_ze(_ze, num_regs);
+			for (size_t r = 0; r < num_regs; ++r) _pEngine->writeMemory_ze(&_ze[r * size], 1, _reg[r]);
 		}
 
 		return true;
@@ -1057,12 +1209,12 @@ public:
 
 		const size_t size = getSize(), num_regs = (nregs != 0) ? nregs : _num_regs;
 
-		_pEngine->readMemory_z(_z, num_regs);
+		for (size_t r = 0; r < num_regs; ++r) _pEngine->readMemory_z(&_z[r * size], 1, _reg[r]);
 		if (!cFile.write(reinterpret_cast<const char *>(_z), sizeof(RNS) * size * num_regs)) return;
 
 		if (RNS_SIZE == 3)
 		{
-			_pEngine->readMemory_ze(_ze, num_regs);
+			for (size_t r = 0; r < num_regs; ++r) _pEngine->readMemory_ze(&_ze[r * size], 1, _reg[r]);
 			if (!cFile.write(reinterpret_cast<const char *>(_ze), sizeof(RNSe) * size * num_regs)) return;
 		}
 	}
@@ -1074,36 +1226,55 @@ public:
 		RNS * const z = _z;
 		z[0] = RNS(a);
 		for (size_t i = 1; i < size; ++i) z[i] = RNS(0);
-		_pEngine->writeMemory_z(_z);
+		_pEngine->writeMemory_z(_z, 1, _reg[0]);
 
 		if (RNS_SIZE == 3)
 		{
 			RNSe * const ze = _ze;
 			ze[0] = RNSe(a);
 			for (size_t i = 1; i < size; ++i) ze[i] = RNSe(0);
-			_pEngine->writeMemory_ze(_ze);
+			_pEngine->writeMemory_ze(_ze, 1, _reg[0]);
 		}
 	}
 
 	void squareDup(const bool dup) override
 	{
+		_pEngine->setReg0(_reg[0]);
 		_pEngine->square();
 		_pEngine->baseMod(dup);
 	}
 
 	void initMultiplicand(const size_t src) override
 	{
-		_pEngine->initMultiplicand(src);
+		_pEngine->initMultiplicand(_reg[src]);
 	}
 
 	void mul() override
 	{
+		_pEngine->setReg0(_reg[0]);
 		_pEngine->mul();
 		_pEngine->baseMod(false);
 	}
 
 	void copy(const size_t dst, const size_t src) const override
 	{
-		_pEngine->copy(dst, src);
+		_pEngine->copy(_reg[dst], _reg[src]);
+	}
+
+	// Registers are renamed: the kernels address the physical register of r_0, no data is moved
+	void swap(const size_t r1, const size_t r2) override { std::swap(_reg[r1], _reg[r2]); }
+
+	// The multiplicands are sub-buffers of a single buffer, allocated when the limit is set
+	bool selectMultiplicand(const size_t slot) override
+	{
+		if (slot > getMaxMultiplicands()) return false;
+		_pEngine->setRegp(slot);
+		return true;
+	}
+
+	void setMaxMultiplicands(const size_t max_multiplicands) override
+	{
+		transform::setMaxMultiplicands(max_multiplicands);
+		_pEngine->setMultiplicands(max_multiplicands + 1);
 	}
 };
@@ -0,0 +1,108 @@
+/*
+Copyright 2022, Yves Gallot
+
+genefer is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "transform.h"
+
+// Two digits of base b are packed into a limb of base b^2: b^{2^n} + 1 = (b^2)^{2^{n-1}} + 1 (and b^{2^n} - b^{2^{n-1}} + 1 if CYCLO).
+// The computation is done by a transform of (b^2, n - 1), the digits are unpacked by getZi.
+class transformPacked : public transform
+{
+private:
+	transform * const _t;
+	int32_t * const _zl;	// limbs
+
+protected:
+	void getZi(int32_t * const zi) const override
+	{
+		int32_t * const zl = _zl;
+		_t->getZi(zl);
+
+		const int32_t b = static_cast<int32_t>(getB());
+		for (size_t k = 0, size = size_t(1) << (getN() - 1); k < size; ++k)
+		{
+			const int32_t l = zl[k];
+			int32_t r = l % b;
+			if (r > b / 2) r -= b;
+			if (r <= -b / 2) r += b;
+			zi[2 * k + 0] = r; zi[2 * k + 1] = (l - r) / b;
+		}
+	}
+
+	// zi is balanced: |limb| <= b^2 / 2 + b / 2
+	void setZi(const int32_t * const zi) override
+	{
+		int32_t * const zl = _zl;
+
+		const int32_t b = static_cast<int32_t>(getB());
+		for (size_t k = 0, size = size_t(1) << (getN() - 1); k < size; ++k) zl[k] = zi[2 * k + 0] + zi[2 * k + 1] * b;
+
+		_t->setZi(zl);
+	}
+
+public:
+	transformPacked(const uint32_t b, const uint32_t n, transform * const t) : transform(t->getSize(), n, b, t->getKind()),
+		_t(t), _zl(new int32_t[size_t(1) << (n - 1)]) {}
+
+	virtual ~transformPacked()
+	{
+		delete _t;
+		delete[] _zl;
+	}
+
+	void set(const int32_t a) override { _t->set(a); }
+	void squareDup(const bool dup) override { _t->squareDup(dup); }
+	void initMultiplicand(const size_t src) override { _t->initMultiplicand(src); }
+	void mul() override { _t->mul(); }
+	void copy(const size_t dst, const size_t src) const override { _t->copy(dst, src); }
+	void swap(const size_t r1, const size_t r2) override { _t->swap(r1, r2); }
+	void mulTo(const size_t dst, const size_t src1, const size_t src2) override { _t->mulTo(dst, src1, src2); }
+	bool selectMultiplicand(const size_t slot) override { return _t->selectMultiplicand(slot); }
+	void setMaxMultiplicands(const size_t max_multiplicands) override { _t->setMaxMultiplicands(max_multiplicands); }
+
+	size_t getMemSize() const override { return _t->getMemSize() + (size_t(1) << (getN() - 1)) * sizeof(int32_t); }
+	size_t getCacheSize() const override { return _t->getCacheSize(); }
+
+	std::string getKindName() const override { return _t->getKindName() + "x2"; }
+
+	bool readContext(file & cFile, const size_t num_regs) override
+	{
+		int kind = 0;
+		if (!cFile.read(reinterpret_cast<char *>(&kind), sizeof(kind))) return false;
+		if (kind != packed_kind) return false;
+		return _t->readContext(cFile, num_regs);
+	}
+
+	void saveContext(file & cFile, const size_t num_regs) const override
+	{
+		const int kind = packed_kind;
+		if (!cFile.write(reinterpret_cast<const char *>(&kind), sizeof(kind))) return;
+		_t->saveContext(cFile, num_regs);
+	}
+
+	double getError() const override { return _t->getError(); }
+	void resetError() override { _t->resetError(); }
+	void setCheckError(const bool checkError) override { _t->setCheckError(checkError); }
+
+	bool setBase(const uint32_t b, const bool checkError) override
+	{
+		if (!_t->setBase(b * b, checkError)) return false;
+		setB(b);
+		return true;
+	}
+
+	void setThreadPool(const threadPool::EWait wait) override { _t->setThreadPool(wait); }
+};
+
+inline transform * transform::create_packed(const uint32_t b, const uint32_t n, transform * const pTransform)
+{
+	return new transformPacked(b, n, pTransform);
+}
@@ -9,7 +9,7 @@ Please give feedback to the authors if improvement is realized. It is distribute
 
 #include "transformCPUi32.h"
 
-transform * transform::create_i32(const uint32_t b, const uint32_t n, const size_t num_regs)
+transform * transform::create_i32(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs)
 {
-	return new transformCPUi32(b, n, num_regs);
+	return new transformCPUi32(b, n, num_threads, num_regs);
 }
@@ -11,16 +11,11 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #include "transformCPUf64.h"
 #include "transformCPUf64s.h"
 
-transform * transform::create_neon(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError)
+transform * transform::create_neon(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+									const EFamily family)
 {
 	// Vect 2 are faster than 4 on Apple M1/M2
 
-#if defined(DTRANSFORM) || defined(IBDTRANSFORM)
-	return transformCPU_neon::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError);
-#elif defined(SBDTRANSFORM)
-	return transformCPU_neon::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
-#else
-	if (n > 17) return transformCPU_neon::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError);
-	else return transformCPU_neon::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
-#endif
+	if (family == EFamily::SBDT) return transformCPU_neon::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
+	return transformCPU_neon::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError, family == EFamily::IBDT);
 }
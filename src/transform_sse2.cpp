@@ -10,15 +10,16 @@ Please give feedback to the authors if improvement is realized. It is distribute
 #define transformCPU_namespace	transformCPU_sse2
 #include "transformCPUf64.h"
 #include "transformCPUf64s.h"
+#include "transformCPUf64b.h"
 
-transform * transform::create_sse2(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError)
+transform * transform::create_sse2(const uint32_t b, const uint32_t n, const size_t num_threads, const size_t num_regs, const bool checkError,
+									const EFamily family)
 {
-#if defined(DTRANSFORM) || defined(IBDTRANSFORM)
-	return transformCPU_sse2::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError);
-#elif defined(SBDTRANSFORM)
-	return transformCPU_sse2::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
-#else
-	if (n > 17) return transformCPU_sse2::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError);
-	else return transformCPU_sse2::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
-#endif
+	if (family == EFamily::SBDT) return transformCPU_sse2::create_transformCPUf64s<2>(b, n, num_threads, num_regs, checkError);
+	return transformCPU_sse2::create_transformCPUf64<2>(b, n, num_threads, num_regs, checkError, family == EFamily::IBDT);
+}
+
+transformBatch * transformBatch::create_sse2(const uint32_t * const b, const uint32_t n, const size_t num_regs, const bool checkError)
+{
+	return transformCPU_sse2::create_transformCPUf64b<2>(b, n, num_regs, checkError);
 }
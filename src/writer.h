@@ -0,0 +1,216 @@
+/*
+Copyright 2022, Yves Gallot
+
+genefer is free source code, under the MIT license (see LICENSE). You can redistribute, use and/or modify it.
+Please give feedback to the authors if improvement is realized. It is distributed in the hope that it will be useful.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/stat.h>
+
+#include "pio.h"
+#include "file.h"
+#include "gint.h"
+
+// Checkpoint files are written by a background thread. The compute thread fills a job with the digit vectors or with a raw register,
+// the inverse transform of a raw register, the conversion, the checksum, the write and the rename are done by the writer.
+// Double buffering: a job can be filled while the previous one is written.
+// pio is not thread-safe: the errors of the writer are reported by the compute thread (acquire, wait).
+class ckptWriter
+{
+public:
+	// The digits of a raw register of a transform: the inverse transform is done by the writer thread
+	class converter
+	{
+	public:
+		virtual ~converter() {}
+		virtual bool getInt(const std::vector<char> & raw, gint & g) = 0;	// false if the raw data are invalid
+	};
+
+	class job
+	{
+		friend class ckptWriter;
+
+	private:
+		std::string _filename;
+		bool _rotate = false, _fatal = false;
+		std::vector<char> _header;
+		std::vector<gint *> _regs;
+		size_t _num_regs = 0;
+		converter * _converter = nullptr;	// if set, the last register is _raw
+		std::vector<char> _raw;
+
+	public:
+		virtual ~job() { for (gint * g : _regs) delete g; }
+
+		// if rotate is set, the file is written as filename.new, then the previous file is renamed filename.old
+		// if fatal is set, a failure is a fatal error
+		void init(const std::string & filename, const bool rotate, const bool fatal)
+		{
+			_filename = filename; _rotate = rotate; _fatal = fatal;
+			_header.clear(); _num_regs = 0; _converter = nullptr;
+		}
+
+		template<typename T>
+		void header(const T & val)
+		{
+			const char * const p = reinterpret_cast<const char *>(&val);
+			_header.insert(_header.end(), p, p + sizeof(T));
+		}
+
+		// staging buffer of the next register
+		gint & reg(const size_t size, const uint32_t base)
+		{
+			if (_num_regs == _regs.size()) _regs.push_back(nullptr);
+			gint * & g = _regs[_num_regs++];
+			if ((g == nullptr) || (g->getSize() != size) || (g->getBase() != base)) { delete g; g = new gint(size, base); }
+			return *g;
+		}
+
+		// staging buffer of the last register: the raw data of a transform, converted by conv in the writer thread
+		std::vector<char> & raw(converter & conv, const size_t size, const uint32_t base)
+		{
+			reg(size, base);
+			_converter = &conv; _raw.clear();
+			return _raw;
+		}
+
+		// raw data are written after the header
+		std::vector<char> & data() { return _header; }
+	};
+
+private:
+	enum class EState { Free, Queued, Writing };
+
+	job _job[2];
+	EState _state[2] = { EState::Free, EState::Free };
+	size_t _next = 0;	// the jobs are filled and written alternately in _job[0] and _job[1]
+	bool _quit = false;
+	std::vector<std::pair<std::string, bool>> _errors;	// message, fatal
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	std::thread _thread;
+
+private:
+	// return an error message, empty if the file is written
+	static std::string write(job & j)
+	{
+		const std::string filename = j._rotate ? j._filename + ".new" : j._filename;
+		if ((j._converter != nullptr) && !j._converter->getInt(j._raw, *j._regs[j._num_regs - 1])) return filename + ": invalid register";
+		std::string errorStr;
+		{
+			file cFile(filename, "wb", errorStr);
+			if (!cFile.exists()) return errorStr;
+			if (!cFile.write(j._header.data(), j._header.size())) return errorStr;
+			for (size_t r = 0; r < j._num_regs; ++r) j._regs[r]->write(cFile);
+			cFile.write_crc32();
+		}
+		if (!errorStr.empty()) return errorStr;
+
+		if (j._rotate)
+		{
+			const std::string oldFilename = j._filename + ".old";
+			std::remove(oldFilename.c_str());
+
+			struct stat s;
+			if ((stat(j._filename.c_str(), &s) == 0) && (std::rename(j._filename.c_str(), oldFilename.c_str()) != 0))	// file exists and cannot rename it
+			{
+				return "cannot save context";
+			}
+
+			if (std::rename(filename.c_str(), j._filename.c_str()) != 0) return "cannot save context";
+		}
+
+		return errorStr;
+	}
+
+	// on the compute thread
+	void report()
+	{
+		std::vector<std::pair<std::string, bool>> errors;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			errors.swap(_errors);
+		}
+		for (const auto & e : errors) pio::error(e.first, e.second);
+	}
+
+	void run()
+	{
+		size_t w = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_cv.wait(lock, [&] { return (_state[w] == EState::Queued) || _quit; });
+				if (_state[w] != EState::Queued) return;
+				_state[w] = EState::Writing;
+			}
+
+			const std::string errorStr = write(_job[w]);
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (!errorStr.empty()) _errors.push_back(std::make_pair(errorStr, _job[w]._fatal));
+				_state[w] = EState::Free;
+			}
+			_cv.notify_all();
+			w ^= 1;
+		}
+	}
+
+public:
+	ckptWriter() : _thread(&ckptWriter::run, this) {}
+
+	// the pending jobs are written before the thread exits
+	virtual ~ckptWriter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_cv.notify_all();
+		_thread.join();
+		report();
+	}
+
+	// the compute thread stalls only if both buffers are in use
+	job & acquire()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [&] { return _state[_next] == EState::Free; });
+		}
+		report();
+		return _job[_next];
+	}
+
+	void submit()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_state[_next] = EState::Queued;
+			_next ^= 1;
+		}
+		_cv.notify_all();
+	}
+
+	// wait until all files are written, the errors are reported
+	void wait()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [&] { return (_state[0] == EState::Free) && (_state[1] == EState::Free); });
+		}
+		report();
+	}
+};